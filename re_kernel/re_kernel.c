@@ -14,6 +14,7 @@
 #include <kpmodule.h>
 #include <kputils.h>
 #include <taskext.h>
+#include <linux/err.h>
 #include <linux/fs.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
@@ -37,8 +38,9 @@ KPM_DESCRIPTION("Re:Kernel, support 4.4 ~ 6.1");
 #define NETLINK_REKERNEL_MAX 26
 #define NETLINK_REKERNEL_MIN 22
 #define USER_PORT 100
-#define PACKET_SIZE 128
+#define PACKET_SIZE 192
 #define MIN_USERAPP_UID 10000
+#define PER_USER_RANGE 100000
 #define MAX_SYSTEM_UID 2000
 
 enum report_type {
@@ -52,23 +54,212 @@ enum binder_type {
   REPLY,
   TRANSACTION,
   OVERFLOW,
+  AUTO_THAW,
 };
 static const char* binder_type[] = {
     "reply",
     "transaction",
     "free_buffer_full",
+    "auto_thaw",
 };
+// netlink 组播组, 订阅者通过 NETLINK_ADD_MEMBERSHIP 加入
+enum rekernel_group {
+  REKERNEL_GROUP_NONE,
+  REKERNEL_GROUP_BINDER,
+  REKERNEL_GROUP_SIGNAL,
+  REKERNEL_GROUP_NETWORK,
+  REKERNEL_GROUP_OVERFLOW,
+  REKERNEL_GROUP_MAX,
+};
+
+// 二进制事件格式, 字段只追加不修改, 追加时提升版本号
+#define REKERNEL_EVENT_VERSION 3
+struct rekernel_event {
+  uint16_t version;
+  uint16_t size;
+  uint8_t type;    // enum report_type
+  uint8_t subtype; // enum binder_type 或 signal
+  uint8_t oneway;
+  uint8_t cpu;
+  int32_t src_pid;
+  uint32_t src_uid;
+  int32_t dst_pid;
+  uint32_t dst_uid;
+  uint64_t timestamp; // CLOCK_MONOTONIC, ns
+  uint32_t suppressed; // v2, 上一个事件之后被限流的同类事件数
+  uint32_t code; // v3, binder 事务码
+  uint32_t iface; // v3, binder 接口描述符的哈希, 0 为未知
+} __attribute__((packed));
+
+// 一次设置全部参数: 最多 BINDER_FILTER_MAX 条过滤规则与 BINDER_POLICY_MAX 条合并策略 (描述符最长 BINDER_IFACE_MAX 个字符),
+// NET_FILTER_MAX 条网络规则 (IPv6 前缀最长 43 个字符), 其余参数不超过 4K
+#define ARGS_RULE_BINDER (BINDER_IFACE_MAX + 32)
+#define ARGS_RULE_NET 96
+#define ARGS_SIZE ((BINDER_FILTER_MAX + BINDER_POLICY_MAX) * ARGS_RULE_BINDER + NET_FILTER_MAX * ARGS_RULE_NET + 4096)
+
+// 解析 struct file 时的扫描范围
+#define PROC_DECODE_FILE_SIZE 0xc0
+#define PROC_DECODE_PDE_SIZE 0x80
+#define PROC_DECODE_FLAGS_MAX 0x1000000
+
+// 每个 CPU 一个环形队列, 由 rekernel 线程批量发送. 每 CPU 表按 nr_cpu_ids 向上取 2 的幂分配,
+// 无法读取时为 REKERNEL_NR_CPUS, 事件中的 cpu 为 u8, 超过 REKERNEL_NR_CPUS_MAX 的 CPU 共用队列
+#define REKERNEL_NR_CPUS 16
+#define REKERNEL_NR_CPUS_MAX 256
+#define EVENT_RING_SIZE 256
+#define EVENT_RING_MASK (EVENT_RING_SIZE - 1)
+#define EVENT_BATCH_DEFAULT 32
+#define EVENT_BATCH_MAX 64
+// 单个 skb 的数据上限, 加上 skb_shared_info 不超过一页, 避免高阶分配, 超出时拆成多个 skb
+#define EVENT_SKB_MAX 3072
+
+// 按 uid 记录的状态, 开放寻址, 槽位只增不删
+#define UID_SLOT_BITS 10
+#define UID_SLOT_SIZE (1 << UID_SLOT_BITS)
+#define UID_SLOT_PROBE 8
+// 令牌以千分之一为单位
+#define TOKEN_SCALE 1000
+#define RATE_MAX 10000
+#define BURST_DEFAULT 10
+
+// 冻结 uid 位图, 以 uid % PER_USER_RANGE - MIN_USERAPP_UID 为下标, 不同用户共用同一位
+#define FROZEN_UID_BITS (PER_USER_RANGE - MIN_USERAPP_UID)
+#define FROZEN_UID_WORDS ((FROZEN_UID_BITS + 63) / 64)
+
+// 过时 oneway 消息索引, 以 (node, code, flags, pid) 为键, 容量不足时覆盖最旧的项
+// 按目标进程分片, 各分片独立加锁与失效
+#define TXN_INDEX_BITS 9
+#define TXN_INDEX_SIZE (1 << TXN_INDEX_BITS)
+#define TXN_INDEX_SHARD_BITS 3
+#define TXN_INDEX_SHARDS (1 << TXN_INDEX_SHARD_BITS)
+
+// 异步缓冲区水位, 空闲空间低于高水位时报告一次, 回到低水位以上后才会再次报告
+#define ASYNC_HIGH_DEFAULT 10
+#define ASYNC_LOW_DEFAULT 20
+#define ASYNC_WATERMARK_BASE 0x300
+// 按进程记录已报告的压力, 表满时退化为每次都报告
+#define ASYNC_PRESSURE_BITS 8
+#define ASYNC_PRESSURE_SIZE (1 << ASYNC_PRESSURE_BITS)
+#define ASYNC_PRESSURE_PROBE 8
+// /proc/rekernel/async 快照大小上限
+#define ASYNC_SNAPSHOT_SIZE (64 * 1024)
+// hook 耗时直方图, 第 i 个桶为 [2^(i-1), 2^i) 个计数器周期
+#define LATENCY_BUCKETS 32
+#define LATENCY_SNAPSHOT_SIZE (16 * 1024)
+
+// oneway 消息合并策略
+#define BINDER_POLICY_MAX 32
+#define BINDER_DROP_MAX 8
+// 压缩时每轮最多处理的进程数, 单个 async_todo 的初始与最大长度, 更长的队列不压缩并计入 compact_skipped
+#define BINDER_COMPACT_TARGETS 64
+#define BINDER_COMPACT_MIN 256
+#define BINDER_COMPACT_MAX 16384
+// 消息内容指纹, 最多计算 BINDER_PAYLOAD_MAX 字节
+#define BINDER_PAYLOAD_MAX 4096
+#define BINDER_PAYLOAD_CHUNK 64
+// 接口描述符最多 BINDER_IFACE_MAX 个字符
+#define BINDER_IFACE_MAX 127
+#define BINDER_IFACE_HEADER (16 + (BINDER_IFACE_MAX + 1) * 2)
+#define BINDER_IFACE_FNV_BASIS 0x811C9DC5
+// binder 报告过滤表, 开放寻址, 规则数不超过槽位的一半
+#define BINDER_FILTER_BITS 9
+#define BINDER_FILTER_SIZE (1 << BINDER_FILTER_BITS)
+#define BINDER_FILTER_MAX (BINDER_FILTER_SIZE / 2)
+// 同步 binder 消息自动解冻, 租约到期或回复后重新冻结
+#define THAW_LEASE_MAX 32
+#define THAW_LEASE_DEFAULT_MS 500
+#define THAW_LEASE_MAX_MS 10000
+#define THAW_PATH_SIZE 96
+#define THAW_CALLERS 8
+enum binder_action {
+  BINDER_ACTION_LEGACY, // 已有两条相同消息时丢弃第二条
+  BINDER_ACTION_LAST,   // 保留最新的 n 条
+  BINDER_ACTION_FIRST,  // 保留最早的 n 条, 丢弃新消息
+  BINDER_ACTION_EXEMPT, // 不合并
+};
+
+// 网络事件合并窗口
+#define NET_WINDOW_DEFAULT_MS 1000
+// 接收队列积压阈值, 超过 NET_BACKLOG_MAX 字节没有意义
+#define NET_BACKLOG_MAX (16 << 20)
+#define NET_DEADLINE_DEFAULT_MS 5000
+enum net_engine {
+  NET_ENGINE_TCP,    // tcp_v4_rcv/tcp_v6_rcv, 每个包一次
+  NET_ENGINE_SOCKET, // netfilter LOCAL_IN, 按 early demux 关联的 socket 判断
+};
+// 网络过滤表, 每条规则占一位, 按维度预先计算规则位集, 命中的最低位即第一条匹配的规则
+#define NET_FILTER_MAX 64
+#define NET_FILTER_CLASSES 256
+#define NET_FILTER_SLOTS 128
+#define NET_FILTER_NONE 2
+enum net_proto {
+  NET_PROTO_TCP,
+  NET_PROTO_UDP,
+  NET_PROTO_MAX,
+};
+
+// 共享内存事件队列, 第一页为 rekernel_mmap_header, 之后为事件数组
+#define MMAP_RING_VERSION 1
+#define MMAP_RING_DATA_OFFSET 4096
+#define MMAP_RING_MIN 64
+#define MMAP_RING_MAX 65536
+// /proc/rekernel/events 队列
+#define EVENTS_QUEUE_MIN 64
+#define EVENTS_QUEUE_MAX 65536
+#define EVENTS_READ_MAX 64
 
 #define IZERO (1UL << 0x10)
 #define UZERO (1UL << 0x20)
 
 // cgroup_freezing, cgroupv1_freeze
 static bool (*cgroup_freezing)(struct task_struct* task);
+// rekernel_parse_args
+int kfunc_def(kstrtoint)(const char* s, unsigned int base, int* res);
+int kfunc_def(kstrtouint)(const char* s, unsigned int base, unsigned int* res);
+unsigned long kfunc_def(__msecs_to_jiffies)(const unsigned int m);
+// rekernel_event_init
+ktime_t kfunc_def(ktime_get)(void);
+static u64 kvar_def(jiffies_64);
+static int kvar_def(cpu_number);
+static unsigned int kvar_def(nr_cpu_ids);
+// rekernel_worker
+struct task_struct* kfunc_def(kthread_create_on_node)(int (*threadfn)(void* data), void* data, int node, const char namefmt[], ...);
+bool kfunc_def(kthread_should_stop)(void);
+int kfunc_def(kthread_stop)(struct task_struct* k);
+int kfunc_def(wake_up_process)(struct task_struct* p);
+long kfunc_def(schedule_timeout_interruptible)(long timeout);
+// rekernel_mmap
+void* kfunc_def(vmalloc_user)(unsigned long size);
+void kfunc_def(vfree)(const void* addr);
+int kfunc_def(remap_vmalloc_range)(struct vm_area_struct* vma, void* addr, unsigned long pgoff);
+void kfunc_def(__init_waitqueue_head)(wait_queue_head_t* wq_head, const char* name, void* key);
+void kfunc_def(__wake_up)(wait_queue_head_t* wq_head, unsigned int mode, int nr, void* key);
+// 5.16 起, 已向下移植到各稳定分支, 没有时卸载后不释放等待队列头
+void kfunc_def(__wake_up_pollfree)(wait_queue_head_t* wq_head);
+void kfunc_def(synchronize_rcu)(void);
+// rekernel_events
+void* kfunc_def(vmalloc)(unsigned long size);
+int kfunc_def(autoremove_wake_function)(struct wait_queue_entry* wq_entry, unsigned mode, int sync, void* key);
+long kfunc_def(prepare_to_wait_event)(wait_queue_head_t* wq_head, struct wait_queue_entry* wq_entry, int state);
+void kfunc_def(finish_wait)(wait_queue_head_t* wq_head, struct wait_queue_entry* wq_entry);
+void kfunc_def(schedule)(void);
+// binder_cgroup_read, binder_cgroup_write
+struct file* kfunc_def(filp_open)(const char* filename, int flags, umode_t mode);
+int kfunc_def(filp_close)(struct file* filp, void* id);
+ssize_t kfunc_def(kernel_read)(struct file* file, void* buf, size_t count, loff_t* pos);
+int kfunc_def(kernfs_path_from_node)(struct kernfs_node* to, struct kernfs_node* from, char* buf, size_t buflen);
+ssize_t kfunc_def(kernel_write)(struct file* file, const void* buf, size_t count, loff_t* pos);
+// hook proc_reg_*
+static ssize_t(*proc_reg_read)(struct file* file, char __user* buf, size_t count, loff_t* ppos);
+static __poll_t(*proc_reg_poll)(struct file* file, struct poll_table_struct* pts);
+static int (*proc_reg_mmap)(struct file* file, struct vm_area_struct* vma);
 // send_netlink_message
 struct sk_buff* kfunc_def(__alloc_skb)(unsigned int size, gfp_t gfp_mask, int flags, int node);
 struct nlmsghdr* kfunc_def(__nlmsg_put)(struct sk_buff* skb, u32 portid, u32 seq, int type, int len, int flags);
 void kfunc_def(kfree_skb)(struct sk_buff* skb);
 int kfunc_def(netlink_unicast)(struct sock* ssk, struct sk_buff* skb, u32 portid, int nonblock);
+int kfunc_def(netlink_broadcast)(struct sock* ssk, struct sk_buff* skb, u32 portid, u32 group, gfp_t allocation);
+int kfunc_def(netlink_has_listeners)(struct sock* sk, unsigned int group);
 // start_rekernel_server
 static struct net kvar_def(init_net);
 struct sock* kfunc_def(__netlink_kernel_create)(struct net* net, int unit, struct module* module, struct netlink_kernel_cfg* cfg);
@@ -85,8 +276,23 @@ static void (*binder_transaction_buffer_release_v6)(struct binder_proc* proc, st
 static void (*binder_transaction_buffer_release_v4)(struct binder_proc* proc, struct binder_buffer* buffer, binder_size_t failed_at, bool is_failure);
 static void (*binder_transaction_buffer_release_v3)(struct binder_proc* proc, struct binder_buffer* buffer, binder_size_t* failed_at);
 static void (*binder_alloc_free_buf)(struct binder_alloc* alloc, struct binder_buffer* buffer);
+// 5.4 以下没有, 此时不支持内容指纹
+static int (*binder_alloc_copy_from_buffer)(struct binder_alloc* alloc, void* dest, struct binder_buffer* buffer, binder_size_t buffer_offset, size_t bytes);
 void kfunc_def(kfree)(const void* objp);
+struct rb_node* kfunc_def(rb_first)(const struct rb_root* root);
+struct rb_node* kfunc_def(rb_next)(const struct rb_node* node);
 static struct binder_stats kvar_def(binder_stats);
+// rekernel_frozen_scan
+static struct hlist_head kvar_def(binder_procs);
+static struct mutex kvar_def(binder_procs_lock);
+void kfunc_def(mutex_lock)(struct mutex* lock);
+void kfunc_def(mutex_unlock)(struct mutex* lock);
+// hook freeze && thaw
+static void (*cgroup_enter_frozen)(void);
+static void (*cgroup_leave_frozen)(bool always_leave);
+static bool (*__refrigerator)(bool check_kthr_stop);
+static ssize_t (*cgroup_freeze_write)(struct kernfs_open_file* of, char* buf, size_t nbytes, loff_t off);
+static bool (*freeze_task)(struct task_struct* p);
 // hook do_send_sig_info
 static int (*do_send_sig_info)(int sig, struct siginfo* info, struct task_struct* p, enum pid_type type);
 
@@ -96,11 +302,22 @@ kuid_t kfunc_def(sock_i_uid)(struct sock* sk);
 // hook tcp_rcv
 static int (*tcp_v4_rcv)(struct sk_buff* skb);
 static int (*tcp_v6_rcv)(struct sk_buff* skb);
+// net_engine=socket
+int kfunc_def(nf_register_net_hooks)(struct net* net, const struct nf_hook_ops* reg, unsigned int n);
+void kfunc_def(nf_unregister_net_hooks)(struct net* net, const struct nf_hook_ops* reg, unsigned int n);
+static struct proto kvar_def(tcp_prot);
+static struct proto kvar_def(tcpv6_prot);
+static struct proto kvar_def(udp_prot);
+static struct proto kvar_def(udpv6_prot);
+// hook __udp_enqueue_schedule_skb
+static int (*__udp_enqueue_schedule_skb)(struct sock* sk, struct sk_buff* skb);
 #endif /* CONFIG_NETWORK */
 
 // _raw_spin_lock && _raw_spin_unlock
 void kfunc_def(_raw_spin_lock)(raw_spinlock_t* lock);
 void kfunc_def(_raw_spin_unlock)(raw_spinlock_t* lock);
+unsigned long kfunc_def(_raw_spin_lock_irqsave)(raw_spinlock_t* lock);
+void kfunc_def(_raw_spin_unlock_irqrestore)(raw_spinlock_t* lock, unsigned long flags);
 // trace
 int kfunc_def(tracepoint_probe_register)(struct tracepoint* tp, void* probe, void* data);
 int kfunc_def(tracepoint_probe_unregister)(struct tracepoint* tp, void* probe, void* data);
@@ -116,6 +333,7 @@ binder_transaction_from_offset = UZERO, binder_transaction_to_proc_offset = UZER
 binder_transaction_code_offset = UZERO, binder_transaction_flags_offset = UZERO,
 binder_node_lock_offset = UZERO,
 binder_node_ptr_offset = UZERO, binder_node_cookie_offset = UZERO, binder_node_has_async_transaction_offset = UZERO, binder_node_async_todo_offset = UZERO,
+binder_node_rb_node_offset = UZERO, binder_node_proc_offset = UZERO,
 binder_proc_outstanding_txns_offset = UZERO, binder_proc_is_frozen_offset = UZERO,
 binder_proc_alloc_offset = UZERO, binder_proc_context_offset = UZERO, binder_proc_inner_lock_offset = UZERO, binder_proc_outer_lock_offset = UZERO,
 binder_alloc_pid_offset = UZERO, binder_alloc_buffer_size_offset = UZERO, binder_alloc_free_async_space_offset = UZERO, binder_alloc_vma_offset = UZERO,
@@ -123,6 +341,43 @@ binder_alloc_pid_offset = UZERO, binder_alloc_buffer_size_offset = UZERO, binder
 binder_transaction_buffer_release_ver6 = UZERO, binder_transaction_buffer_release_ver5 = UZERO, binder_transaction_buffer_release_ver4 = UZERO;
 
 static unsigned long trace = UZERO;
+// UZERO: 文本格式, IZERO: 二进制格式
+static unsigned long rekernel_binary_format = UZERO;
+// UZERO: 同步发送, 否则为批量发送的间隔
+static unsigned long rekernel_flush_ms = UZERO, rekernel_flush_jiffies = UZERO;
+static unsigned long rekernel_batch = EVENT_BATCH_DEFAULT;
+// UZERO: 不限流, 否则为每个 uid 每类事件每秒允许的数量
+static unsigned long rekernel_rate = UZERO, rekernel_burst = BURST_DEFAULT, rekernel_hz = UZERO;
+// IZERO: 每个冻结周期内同一 uid 只报告一次
+static unsigned long rekernel_epoch = UZERO;
+// IZERO: 冻结 uid 位图可用
+static unsigned long rekernel_frozen_bitmap = UZERO;
+// IZERO: 只报告守护进程关心的 uid 与事件类别
+static unsigned long rekernel_interest = UZERO;
+#ifdef CONFIG_NETWORK
+// UZERO: 不合并网络事件
+static unsigned long rekernel_net_window = NET_WINDOW_DEFAULT_MS, rekernel_net_window_jiffies = UZERO;
+static unsigned long rekernel_net_engine = NET_ENGINE_TCP, rekernel_net_hooked = UZERO;
+// IZERO: 有冻结位图, netfilter hook 只在存在冻结 uid 时由 rekernel 线程注册
+static unsigned long rekernel_net_ondemand = UZERO;
+static uint32_t rekernel_net_nf_lock, rekernel_net_nf_registered, rekernel_net_nf_stopped;
+static unsigned long rekernel_net_udp = IZERO;
+// UZERO: 收到数据即报告, 否则接收队列超过阈值或积压超过期限时才报告
+static unsigned long rekernel_net_backlog = UZERO;
+static unsigned long rekernel_net_deadline = NET_DEADLINE_DEFAULT_MS, rekernel_net_deadline_jiffies = UZERO;
+// sock->sk_rmem_alloc, 解析失败时不支持积压阈值
+static uint64_t sock_rmem_alloc_offset = UZERO;
+// sock->sk_uid, 4.10 起创建时取自 SOCK_INODE(socket)->i_uid, fchown 时同步更新, 解析失败时使用 sock_i_uid
+static uint64_t sock_sk_uid_offset = UZERO;
+#endif /* CONFIG_NETWORK */
+// UZERO: 不通过 netlink 发送, 仅使用 /proc/rekernel/ 下的文件
+static unsigned long rekernel_netlink_enabled = IZERO;
+// UZERO: 不单播给 USER_PORT, 仅组播
+static unsigned long rekernel_unicast = IZERO;
+// IZERO: 已 hook proc_reg_*, 可以创建 /proc/rekernel/ 下的文件
+static unsigned long rekernel_proc_hooked = UZERO;
+// file->f_inode, file->f_flags, PDE(inode) 为 inode 之前的 proc_inode->pde, 加载时通过自己的文件解析
+static uint64_t file_inode_offset = UZERO, file_flags_offset = UZERO, proc_inode_pde_offset = UZERO;
 #include "re_offsets.c"
 
 // binder_node_lock
@@ -165,317 +420,3841 @@ static inline bool frozen_task_group(struct task_struct* task) {
   return (jobctl_frozen(task) || cgroup_freezing(task));
 }
 
-// 创建 netlink 服务
-static struct sock* rekernel_netlink;
-static unsigned long rekernel_netlink_unit = UZERO;
-static struct proc_dir_entry* rekernel_dir, * rekernel_unit_entry;
-static const struct file_operations rekernel_unit_fops = {};
+// 位图中置位的 uid 可能有冻结的进程, 未置位的一定没有
+static uint64_t rekernel_frozen_uids[FROZEN_UID_WORDS];
+// 有进程解冻, 需要重新确认的 uid, 由 rekernel 线程处理
+static uint64_t rekernel_frozen_pending[FROZEN_UID_WORDS];
+static uint32_t rekernel_frozen_pending_any;
+// 重新确认期间进入冻结的 uid, 不能被清除
+static uint64_t rekernel_frozen_entered[FROZEN_UID_WORDS];
+// 等待 worker 压缩 async_todo 的 uid, any 为 2 时压缩所有冻结进程
+static uint64_t rekernel_compact_pending[FROZEN_UID_WORDS];
+static uint32_t rekernel_compact_pending_any;
+// UZERO: 冻结时不自动压缩
+static unsigned long rekernel_compact_on_freeze = IZERO;
+// IZERO: 从 binder 消息头中提取接口描述符
+static unsigned long binder_iface = UZERO;
+// IZERO: binder 报告过滤表非空
+static unsigned long binder_filter_active = UZERO;
+// IZERO: 同步消息发往 cgroupv2 冻结的应用时由内核临时解冻
+static unsigned long rekernel_auto_thaw = UZERO;
+static unsigned long rekernel_thaw_lease = THAW_LEASE_DEFAULT_MS, rekernel_thaw_lease_jiffies = UZERO;
+// IZERO: 记录 hook 耗时直方图
+static unsigned long rekernel_latency = UZERO;
+// 异步缓冲区水位, 缓冲区大小的百分比, async_low 为 UZERO 时每次都报告
+static unsigned long rekernel_async_high = ASYNC_HIGH_DEFAULT, rekernel_async_low = ASYNC_LOW_DEFAULT;
 
-static int start_rekernel_server(void) {
-  if (rekernel_netlink_unit != UZERO) {
+static inline bool rekernel_uid_maybe_frozen(uid_t uid) {
+  if (rekernel_frozen_bitmap != IZERO)
+    return true;
+  uint32_t index = uid % PER_USER_RANGE;
+  if (index < MIN_USERAPP_UID)
+    return true;
+  index -= MIN_USERAPP_UID;
+  return (smp_load_acquire(&rekernel_frozen_uids[index / 64]) >> (index % 64)) & 1;
+}
+
+static inline void rekernel_uid_mark(uint64_t* bitmap, uid_t uid) {
+  uint32_t index = uid % PER_USER_RANGE;
+  if (index < MIN_USERAPP_UID)
+    return;
+  index -= MIN_USERAPP_UID;
+  if (!((smp_load_acquire(&bitmap[index / 64]) >> (index % 64)) & 1))
+    or_u64(&bitmap[index / 64], 1UL << (index % 64));
+}
+
+// 守护进程上传的关注集合, 每个 uid 一个字节, 第 n 位对应组播组 n + 1
+static uint8_t* rekernel_interest_masks;
+
+static inline bool rekernel_interested(uid_t uid, int group) {
+  if (rekernel_interest != IZERO)
+    return true;
+  uint32_t index = uid % PER_USER_RANGE;
+  if (index < MIN_USERAPP_UID)
+    return true;
+  return (rekernel_interest_masks[index - MIN_USERAPP_UID] >> (group - 1)) & 1;
+}
+
+// 格式: off | clear | uid:mask[,uid:mask...]
+static long rekernel_set_interest(char* value) {
+  if (!strcmp(value, "off")) {
+    rekernel_interest = UZERO;
     return 0;
   }
-  struct netlink_kernel_cfg rekernel_cfg = {};
-
-  for (rekernel_netlink_unit = NETLINK_REKERNEL_MAX; rekernel_netlink_unit >= NETLINK_REKERNEL_MIN; rekernel_netlink_unit--) {
-    rekernel_netlink = netlink_kernel_create(kvar(init_net), rekernel_netlink_unit, &rekernel_cfg);
-    if (rekernel_netlink != NULL) {
-      break;
-    }
+  if (!rekernel_interest_masks) {
+    uint8_t* masks = vmalloc(FROZEN_UID_BITS);
+    if (!masks)
+      return -ENOMEM;
+    memset(masks, 0, FROZEN_UID_BITS);
+    smp_store_release(&rekernel_interest_masks, masks);
   }
-  if (rekernel_netlink == NULL) {
-    printk("Failed to create Re:Kernel server!\n");
-    return -1;
+  if (!strcmp(value, "clear")) {
+    memset(rekernel_interest_masks, 0, FROZEN_UID_BITS);
+    rekernel_interest = IZERO;
+    return 0;
   }
-  printk("Created Re:Kernel server! NETLINK UNIT: %d\n", rekernel_netlink_unit);
 
-  rekernel_dir = proc_mkdir("rekernel", NULL);
-  if (!rekernel_dir) {
-    printk("create /proc/rekernel failed!\n");
-  } else {
-    char buff[32];
-    sprintf(buff, "%d", rekernel_netlink_unit);
-    rekernel_unit_entry = proc_create(buff, 0400, rekernel_dir, &rekernel_unit_fops);
-    if (!rekernel_unit_entry) {
-      printk("create rekernel unit failed!\n");
-    }
-  }
+  char* p = value;
+  while (*p) {
+    char* entry = p;
+    while (*p && *p != ',')
+      p++;
+    if (*p)
+      *p++ = '\0';
 
+    char* mask_str = entry;
+    while (*mask_str && *mask_str != ':')
+      mask_str++;
+    if (*mask_str != ':')
+      return -EINVAL;
+    *mask_str++ = '\0';
+
+    int uid, mask;
+    if (kstrtoint(entry, 0, &uid) || kstrtoint(mask_str, 0, &mask))
+      return -EINVAL;
+    uint32_t index = uid % PER_USER_RANGE;
+    if (uid < 0 || index < MIN_USERAPP_UID || mask < 0 || mask > 0xFF)
+      return -ERANGE;
+    rekernel_interest_masks[index - MIN_USERAPP_UID] = mask;
+  }
+  rekernel_interest = IZERO;
   return 0;
 }
-// 发送 netlink 消息
-static int send_netlink_message(char* msg, uint16_t len) {
-  struct sk_buff* skbuffer;
-  struct nlmsghdr* nlhdr;
 
-  skbuffer = nlmsg_new(len, GFP_ATOMIC);
-  if (!skbuffer) {
-    printk("netlink alloc failure.\n");
-    return -1;
+// 热路径先查位图, 置位后再做完整判断
+static inline bool rekernel_task_frozen(struct task_struct* task) {
+  if (!rekernel_uid_maybe_frozen(task_uid(task).val))
+    return false;
+  return frozen_task_group(task);
+}
+
+// arch/arm64/include/asm/percpu.h, VHE 内核运行在 EL2, percpu 偏移保存在 tpidr_el2
+static unsigned long rekernel_vhe = UZERO;
+// 每 CPU 表的项数, 为 2 的幂
+static uint32_t rekernel_nr_cpus;
+
+static inline int rekernel_cpu(void) {
+  if (!kvar(cpu_number))
+    return 0;
+  unsigned long offset;
+  if (rekernel_vhe == IZERO)
+    asm volatile("mrs %0, tpidr_el2" : "=r"(offset));
+  else
+    asm volatile("mrs %0, tpidr_el1" : "=r"(offset));
+  return *(int*)((uintptr_t)kvar(cpu_number) + offset);
+}
+
+static inline uint32_t rekernel_cpu_slot(void) {
+  return rekernel_cpu() & (rekernel_nr_cpus - 1);
+}
+
+static void rekernel_cpu_init(void) {
+  unsigned long el;
+  asm volatile("mrs %0, CurrentEL" : "=r"(el));
+  rekernel_vhe = ((el >> 2) & 3) == 2 ? IZERO : UZERO;
+
+  uint32_t nr = kvar(nr_cpu_ids) ? *kvar(nr_cpu_ids) : REKERNEL_NR_CPUS;
+  if (nr > REKERNEL_NR_CPUS_MAX)
+    nr = REKERNEL_NR_CPUS_MAX;
+  rekernel_nr_cpus = 1;
+  while (rekernel_nr_cpus < nr)
+    rekernel_nr_cpus <<= 1;
+  logkm("nr_cpus=%u vhe=%d\n", rekernel_nr_cpus, rekernel_vhe == IZERO);
+}
+
+// 统计计数, 每个 CPU 一份, 读取时求和
+enum rekernel_stat {
+  REKERNEL_STAT_REPORT, // 按组计数, 共 REKERNEL_GROUP_MAX 项
+  REKERNEL_STAT_FILTERED = REKERNEL_STAT_REPORT + REKERNEL_GROUP_MAX,
+  REKERNEL_STAT_THROTTLED,
+  REKERNEL_STAT_QUEUE_DROPPED,
+  REKERNEL_STAT_NETLINK_FAIL,
+  REKERNEL_STAT_ALLOC_FAIL,
+  REKERNEL_STAT_TXN_FREED,
+  REKERNEL_STAT_TXN_BYTES,
+  REKERNEL_STAT_AUTO_THAW,
+  REKERNEL_STAT_COMPACT_SKIPPED,
+  REKERNEL_STAT_MAX,
+};
+static const char* rekernel_stat_name[REKERNEL_STAT_MAX] = {
+    [REKERNEL_STAT_REPORT + REKERNEL_GROUP_BINDER] = "report_binder",
+    [REKERNEL_STAT_REPORT + REKERNEL_GROUP_SIGNAL] = "report_signal",
+    [REKERNEL_STAT_REPORT + REKERNEL_GROUP_NETWORK] = "report_network",
+    [REKERNEL_STAT_REPORT + REKERNEL_GROUP_OVERFLOW] = "report_overflow",
+    [REKERNEL_STAT_FILTERED] = "filtered",
+    [REKERNEL_STAT_THROTTLED] = "throttled",
+    [REKERNEL_STAT_QUEUE_DROPPED] = "queue_dropped",
+    [REKERNEL_STAT_NETLINK_FAIL] = "netlink_fail",
+    [REKERNEL_STAT_ALLOC_FAIL] = "alloc_fail",
+    [REKERNEL_STAT_TXN_FREED] = "txn_freed",
+    [REKERNEL_STAT_TXN_BYTES] = "txn_bytes",
+    [REKERNEL_STAT_AUTO_THAW] = "auto_thaw",
+    [REKERNEL_STAT_COMPACT_SKIPPED] = "compact_skipped",
+};
+struct rekernel_stats {
+  uint64_t count[REKERNEL_STAT_MAX];
+} __attribute__((aligned(64)));
+static struct rekernel_stats* rekernel_stats;
+// 重置时记录当前总和, 读取时减去, 不改写其他 CPU 的计数
+static uint64_t rekernel_stats_base[REKERNEL_STAT_MAX];
+
+// 不使用原子操作, 被抢占迁移时偶尔丢失一次计数
+static inline void rekernel_stat_add(int stat, uint64_t n) {
+  rekernel_stats[rekernel_cpu_slot()].count[stat] += n;
+}
+
+static inline void rekernel_stat_inc(int stat) {
+  rekernel_stat_add(stat, 1);
+}
+
+static uint64_t rekernel_stat_sum(int stat) {
+  uint64_t sum = 0;
+  for (uint32_t cpu = 0; cpu < rekernel_nr_cpus; cpu++) {
+    sum += *(volatile uint64_t*)&rekernel_stats[cpu].count[stat];
   }
+  return sum;
+}
 
-  nlhdr = nlmsg_put(skbuffer, 0, 0, rekernel_netlink_unit, len, 0);
-  if (!nlhdr) {
-    printk("nlmsg_put failaure.\n");
-    nlmsg_free(skbuffer);
-    return -1;
+static void rekernel_stats_reset(void) {
+  for (int i = 0; i < REKERNEL_STAT_MAX; i++) {
+    rekernel_stats_base[i] = rekernel_stat_sum(i);
   }
+}
 
-  memcpy(nlmsg_data(nlhdr), msg, len);
-  return netlink_unicast(rekernel_netlink, skbuffer, USER_PORT, MSG_DONTWAIT);
+// hook 耗时, 以 arm64 虚拟计数器 (cntvct_el0) 计时, 每个 CPU 一份 log2 直方图
+enum rekernel_latency_type {
+  LATENCY_BINDER_PROC_TRANSACTION,
+  LATENCY_BINDER_TRANSACTION,
+  LATENCY_SEND_SIG_INFO,
+  LATENCY_TCP_RCV,
+  LATENCY_UDP_ENQUEUE,
+  LATENCY_NF_LOCAL_IN,
+  LATENCY_MAX,
+};
+static const char* rekernel_latency_name[LATENCY_MAX] = {
+    "binder_proc_transaction",
+    "binder_transaction",
+    "do_send_sig_info",
+    "tcp_rcv",
+    "udp_enqueue",
+    "nf_local_in",
+};
+struct rekernel_latency_hist {
+  uint64_t bucket[LATENCY_MAX][LATENCY_BUCKETS];
+} __attribute__((aligned(64)));
+static struct rekernel_latency_hist* rekernel_latency_hists;
+
+static inline uint64_t rekernel_cntvct(void) {
+  uint64_t cnt;
+  asm volatile("isb; mrs %0, cntvct_el0" : "=r"(cnt) : : "memory");
+  return cnt;
+}
+
+static inline uint64_t rekernel_cntfrq(void) {
+  uint64_t freq;
+  asm volatile("mrs %0, cntfrq_el0" : "=r"(freq));
+  return freq;
+}
+
+// 关闭时只有一次读取与比较, 返回 0 表示不记录
+static inline uint64_t rekernel_latency_begin(void) {
+  if (likely(rekernel_latency == UZERO))
+    return 0;
+  return rekernel_cntvct();
 }
 
-static void rekernel_report(int reporttype, int type, pid_t src_pid, struct task_struct* src, pid_t dst_pid, struct task_struct* dst, bool oneway) {
-  if (start_rekernel_server() != 0)
+static inline void rekernel_latency_end(int type, uint64_t start) {
+  if (likely(!start))
     return;
+  uint64_t delta = rekernel_cntvct() - start;
+  int bucket = delta ? 64 - __builtin_clzll(delta) : 0;
+  if (bucket >= LATENCY_BUCKETS)
+    bucket = LATENCY_BUCKETS - 1;
+  rekernel_latency_hists[rekernel_cpu_slot()].bucket[type][bucket]++;
+}
 
-#ifdef CONFIG_NETWORK
-  if (reporttype == NETWORK) {
-    char binder_kmsg[PACKET_SIZE];
-    snprintf(binder_kmsg, sizeof(binder_kmsg), "type=Network,target=%d;", dst_pid);
-#ifdef CONFIG_DEBUG
-    logkm("%s\n", binder_kmsg);
-#endif /* CONFIG_DEBUG */
-    send_netlink_message(binder_kmsg, strlen(binder_kmsg));
+static void rekernel_latency_reset(void) {
+  memset(rekernel_latency_hists, 0, rekernel_nr_cpus * sizeof(struct rekernel_latency_hist));
+}
+
+// 共享内存事件队列, 内核只写 head, 用户态只写 tail
+struct rekernel_mmap_header {
+  uint32_t version;
+  uint32_t event_size;
+  uint32_t nr_events;
+  uint32_t data_offset;
+  uint64_t dropped;
+  uint32_t head __attribute__((aligned(64)));
+  uint32_t tail __attribute__((aligned(64)));
+};
+static struct rekernel_mmap_header* rekernel_mmap_ring;
+static unsigned long rekernel_mmap_nr = UZERO;
+static uint32_t rekernel_mmap_head;
+static spinlock_t rekernel_mmap_lock;
+// 等待队列头单独分配, epoll 项在文件关闭前一直引用它, 见 rekernel_wait_release
+static wait_queue_head_t* rekernel_mmap_wait;
+
+static wait_queue_head_t* rekernel_wait_alloc(void) {
+  wait_queue_head_t* wait = vmalloc(sizeof(wait_queue_head_t));
+  if (wait)
+    init_waitqueue_head(wait);
+  return wait;
+}
+
+// 有 wake_up_pollfree 时通知 epoll 摘除等待项, 等待 RCU 读者退出后释放
+// 否则等待项可能在卸载后仍被引用, 不释放
+static void rekernel_wait_release(wait_queue_head_t** wait) {
+  if (!*wait)
     return;
+  if (kfunc(__wake_up_pollfree) && kfunc(synchronize_rcu)) {
+    wake_up_pollfree(*wait);
+    synchronize_rcu();
+    vfree(*wait);
+  } else {
+    logkm("__wake_up_pollfree not found, keep wait queue head\n");
   }
-#endif /* CONFIG_NETWORK */
+  *wait = NULL;
+}
 
-  if (!frozen_task_group(dst))
-    return;
+static long rekernel_mmap_alloc(unsigned long nr) {
+  if (!rekernel_mmap_wait) {
+    rekernel_mmap_wait = rekernel_wait_alloc();
+    if (!rekernel_mmap_wait)
+      return -ENOMEM;
+  }
+  struct rekernel_mmap_header* header = vmalloc_user(MMAP_RING_DATA_OFFSET + nr * sizeof(struct rekernel_event));
+  if (!header)
+    return -ENOMEM;
 
-  if (task_uid(src).val == task_uid(dst).val)
-    return;
+  header->version = MMAP_RING_VERSION;
+  header->event_size = sizeof(struct rekernel_event);
+  header->nr_events = nr;
+  header->data_offset = MMAP_RING_DATA_OFFSET;
+  rekernel_mmap_nr = nr;
+  smp_store_release(&rekernel_mmap_ring, header);
+  return 0;
+}
 
-  char binder_kmsg[PACKET_SIZE];
-  switch (reporttype) {
-  case BINDER:
-    snprintf(binder_kmsg, sizeof(binder_kmsg), "type=Binder,bindertype=%s,oneway=%d,from_pid=%d,from=%d,target_pid=%d,target=%d;", binder_type[type], oneway, src_pid, task_uid(src).val, dst_pid, task_uid(dst).val);
-    break;
-  case SIGNAL:
-    snprintf(binder_kmsg, sizeof(binder_kmsg), "type=Signal,signal=%d,killer_pid=%d,killer=%d,dst_pid=%d,dst=%d;", type, src_pid, task_uid(src).val, dst_pid, task_uid(dst).val);
-    break;
-  default:
-    return;
+static void rekernel_mmap_push(const struct rekernel_event* event) {
+  struct rekernel_mmap_header* header = rekernel_mmap_ring;
+  struct rekernel_event* events = (struct rekernel_event*)((uintptr_t)header + MMAP_RING_DATA_OFFSET);
+  unsigned long flags;
+
+  spin_lock_irqsave(&rekernel_mmap_lock, flags);
+  // 共享页中的 head 可能被用户态改写, 以内核副本为准
+  uint32_t head = rekernel_mmap_head;
+  if (head - smp_load_acquire(&header->tail) >= rekernel_mmap_nr) {
+    header->dropped++;
+    rekernel_stat_inc(REKERNEL_STAT_QUEUE_DROPPED);
+  } else {
+    events[head & (rekernel_mmap_nr - 1)] = *event;
+    rekernel_mmap_head = head + 1;
+    smp_store_release(&header->head, head + 1);
   }
-#ifdef CONFIG_DEBUG
-  logkm("%s\n", binder_kmsg);
-  logkm("src_comm=%s,dst_comm=%s\n", get_task_comm(src), get_task_comm(dst));
-#endif /* CONFIG_DEBUG */
-#ifdef CONFIG_DEBUG_CMDLINE
-  char src_cmdline[PATH_MAX], dst_cmdline[PATH_MAX];
-  memset(&src_cmdline, 0, PATH_MAX);
-  memset(&dst_cmdline, 0, PATH_MAX);
-  int res = 0;
-  res = get_cmdline(src, src_cmdline, PATH_MAX - 1);
-  src_cmdline[res] = '\0';
-  res = get_cmdline(dst, dst_cmdline, PATH_MAX - 1);
-  dst_cmdline[res] = '\0';
-  logkm("src_cmdline=%s,dst_cmdline=%s\n", src_cmdline, dst_cmdline);
-#endif /* CONFIG_DEBUG_CMDLINE */
-  send_netlink_message(binder_kmsg, strlen(binder_kmsg));
+  spin_unlock_irqrestore(&rekernel_mmap_lock, flags);
+
+  if (wq_has_sleeper(rekernel_mmap_wait))
+    wake_up_interruptible(rekernel_mmap_wait);
 }
 
-static void binder_reply_handler(pid_t src_pid, struct task_struct* src, pid_t dst_pid, struct task_struct* dst, bool oneway) {
-  if (unlikely(!dst))
-    return;
-  if (task_uid(dst).val > MAX_SYSTEM_UID || src_pid == dst_pid)
-    return;
+static inline bool rekernel_mmap_empty(void) {
+  return smp_load_acquire(&rekernel_mmap_ring->tail) == smp_load_acquire(&rekernel_mmap_head);
+}
 
-  // oneway=0
-  rekernel_report(BINDER, REPLY, src_pid, src, dst_pid, dst, oneway);
+// compat_copy_to_user 返回实际拷贝的字节数
+static inline bool rekernel_copy_to_user(void __user* to, const void* from, size_t n) {
+  return compat_copy_to_user(to, from, n) == (int)n;
 }
 
-static void binder_trans_handler(pid_t src_pid, struct task_struct* src, pid_t dst_pid, struct task_struct* dst, bool oneway) {
-  if (unlikely(!dst))
-    return;
-  if ((task_uid(dst).val <= MIN_USERAPP_UID) || src_pid == dst_pid)
-    return;
+// 卸载时先置 rekernel_exiting 并唤醒读者, 等仍在 proc_reg_* hook 中的读者全部退出后再释放队列
+static unsigned long rekernel_exiting = UZERO;
+static uint32_t rekernel_proc_users;
 
-  rekernel_report(BINDER, TRANSACTION, src_pid, src, dst_pid, dst, oneway);
+static inline bool rekernel_proc_enter(void) {
+  add_return_u32(&rekernel_proc_users, 1);
+  smp_mb();
+  if (rekernel_exiting == IZERO) {
+    add_return_u32(&rekernel_proc_users, -1);
+    return false;
+  }
+  return true;
 }
 
-static void binder_overflow_handler(pid_t src_pid, struct task_struct* src, pid_t dst_pid, struct task_struct* dst, bool oneway) {
-  if (unlikely(!dst))
-    return;
+static inline void rekernel_proc_leave(void) {
+  add_return_u32(&rekernel_proc_users, -1);
+}
 
-  // oneway=1
-  rekernel_report(BINDER, OVERFLOW, src_pid, src, dst_pid, dst, oneway);
+// 有界事件队列, 通过 read()/poll() 读取, 满时丢弃新事件
+static struct rekernel_event* rekernel_events_queue;
+static unsigned long rekernel_events_nr = UZERO;
+static uint32_t rekernel_events_head, rekernel_events_tail;
+static uint64_t rekernel_events_dropped;
+static spinlock_t rekernel_events_lock;
+static wait_queue_head_t* rekernel_events_wait;
+
+static long rekernel_events_alloc(unsigned long nr) {
+  if (!rekernel_events_wait) {
+    rekernel_events_wait = rekernel_wait_alloc();
+    if (!rekernel_events_wait)
+      return -ENOMEM;
+  }
+  struct rekernel_event* queue = vmalloc(nr * sizeof(struct rekernel_event));
+  if (!queue)
+    return -ENOMEM;
+
+  rekernel_events_nr = nr;
+  smp_store_release(&rekernel_events_queue, queue);
+  return 0;
 }
 
-static void rekernel_binder_transaction(void* data, bool reply, struct binder_transaction* t, struct binder_node* target_node) {
-  struct binder_proc* to_proc = binder_transaction_to_proc(t);
-  if (!to_proc)
-    return;
-  struct binder_thread* from = binder_transaction_from(t);
+static void rekernel_events_push(const struct rekernel_event* event) {
+  unsigned long flags;
 
-  if (reply) {
-    binder_reply_handler(task_pid(current), current, to_proc->pid, to_proc->tsk, false);
-  } else if (from) {
-    if (from->proc) {
-      binder_trans_handler(from->proc->pid, from->proc->tsk, to_proc->pid, to_proc->tsk, false);
-    }
-  } else { // oneway=1
-    // binder_trans_handler(task_pid(current), current, to_proc->pid, to_proc->tsk, true);
+  spin_lock_irqsave(&rekernel_events_lock, flags);
+  uint32_t head = rekernel_events_head;
+  if (head - rekernel_events_tail >= rekernel_events_nr) {
+    rekernel_events_dropped++;
+    rekernel_stat_inc(REKERNEL_STAT_QUEUE_DROPPED);
+  } else {
+    rekernel_events_queue[head & (rekernel_events_nr - 1)] = *event;
+    smp_store_release(&rekernel_events_head, head + 1);
+  }
+  spin_unlock_irqrestore(&rekernel_events_lock, flags);
 
-    struct binder_alloc* target_alloc = binder_proc_alloc(to_proc);
-    size_t free_async_space = binder_alloc_free_async_space(target_alloc);
-    size_t buffer_size = binder_alloc_buffer_size(target_alloc);
-    if (free_async_space < (buffer_size / 10 + 0x300)) {
-      binder_overflow_handler(task_pid(current), current, to_proc->pid, to_proc->tsk, true);
-    }
+  if (wq_has_sleeper(rekernel_events_wait))
+    wake_up_interruptible(rekernel_events_wait);
+}
+
+// 只拷贝不出队, 拷贝到用户态成功后再 rekernel_events_commit, 失败时事件仍留在队列中
+static int rekernel_events_peek(struct rekernel_event* events, int count, uint32_t* start) {
+  unsigned long flags;
+  int n = 0;
+
+  spin_lock_irqsave(&rekernel_events_lock, flags);
+  uint32_t tail = rekernel_events_tail;
+  *start = tail;
+  while (n < count && tail != rekernel_events_head) {
+    events[n++] = rekernel_events_queue[tail & (rekernel_events_nr - 1)];
+    tail++;
   }
+  spin_unlock_irqrestore(&rekernel_events_lock, flags);
+  return n;
 }
 
-static bool binder_can_update_transaction(struct binder_transaction* t1, struct binder_transaction* t2) {
-  struct binder_proc* t1_to_proc = binder_transaction_to_proc(t1);
-  struct binder_buffer* t1_buffer = binder_transaction_buffer(t1);
-  unsigned int t1_code = binder_transaction_code(t1);
-  unsigned int t1_flags = binder_transaction_flags(t1);
-  binder_uintptr_t t1_ptr = binder_node_ptr(t1_buffer->target_node);
-  binder_uintptr_t t1_cookie = binder_node_cookie(t1_buffer->target_node);
+// 多个读者同时读取时, 同一批事件可能被重复读到, 但不会丢失
+static void rekernel_events_commit(uint32_t start, int n) {
+  unsigned long flags;
 
-  struct binder_proc* t2_to_proc = binder_transaction_to_proc(t2);
-  struct binder_buffer* t2_buffer = binder_transaction_buffer(t2);
-  unsigned int t2_code = binder_transaction_code(t2);
-  unsigned int t2_flags = binder_transaction_flags(t2);
-  binder_uintptr_t t2_ptr = binder_node_ptr(t2_buffer->target_node);
-  binder_uintptr_t t2_cookie = binder_node_cookie(t2_buffer->target_node);
+  spin_lock_irqsave(&rekernel_events_lock, flags);
+  if (rekernel_events_tail == start)
+    smp_store_release(&rekernel_events_tail, start + n);
+  spin_unlock_irqrestore(&rekernel_events_lock, flags);
+}
 
-  if ((t1_flags & t2_flags & TF_ONE_WAY) != TF_ONE_WAY || !t1_to_proc || !t2_to_proc)
-    return false;
-  if (t1_to_proc->tsk == t2_to_proc->tsk
-    && t1_code == t2_code
-    && t1_flags == t2_flags
-    && (binder_proc_is_frozen_offset == UZERO ? true : t1_buffer->pid == t2_buffer->pid) // 4.19 以下无此数据
-    && t1_ptr == t2_ptr
-    && t1_cookie == t2_cookie)
-    return true;
-  return false;
+static inline bool rekernel_events_empty(void) {
+  return smp_load_acquire(&rekernel_events_head) == smp_load_acquire(&rekernel_events_tail);
 }
 
-static struct binder_transaction* binder_find_outdated_transaction_ilocked(struct binder_transaction* t, struct list_head* target_list) {
-  struct binder_work* w;
-  bool second = false;
+static long rekernel_events_wait_event(void) {
+  struct wait_queue_entry wait;
+  long ret = 0;
 
-  list_for_each_entry(w, target_list, entry) {
-    if (w->type != BINDER_WORK_TRANSACTION)
-      continue;
-    struct binder_transaction* t_queued = container_of(w, struct binder_transaction, work);
-    if (binder_can_update_transaction(t_queued, t)) {
-      if (second)
-        return t_queued;
-      else
-        second = true;
+  init_wait_entry(&wait, 0);
+  for (;;) {
+    long intr = prepare_to_wait_event(rekernel_events_wait, &wait, TASK_INTERRUPTIBLE);
+    if (!rekernel_events_empty() || rekernel_exiting == IZERO)
+      break;
+    if (intr) {
+      ret = intr;
+      break;
     }
+    schedule();
   }
-  return NULL;
+  finish_wait(rekernel_events_wait, &wait);
+  return ret;
 }
 
-static inline void outstanding_txns_dec(struct binder_proc* proc) {
-  if (binder_proc_outstanding_txns_offset != UZERO) {
-    int* outstanding_txns = binder_proc_outstanding_txns(proc);
-    (*outstanding_txns)--;
+static int rekernel_format_event(const struct rekernel_event* event, char* buf, size_t size);
+
+// 每次 read 返回整数个事件, 二进制格式为 struct rekernel_event 数组, 文本格式每行一个事件
+static ssize_t rekernel_events_read(struct file* file, char __user* buf, size_t count) {
+  size_t record_size = rekernel_binary_format == IZERO ? sizeof(struct rekernel_event) : PACKET_SIZE;
+  if (count < record_size)
+    return -EINVAL;
+
+  if (rekernel_events_empty()) {
+    if (file_flags(file) & O_NONBLOCK)
+      return -EAGAIN;
+    long rc = rekernel_events_wait_event();
+    if (rc < 0)
+      return rc;
+  }
+
+  struct rekernel_event events[EVENTS_READ_MAX];
+  size_t copied = 0;
+  while (count - copied >= record_size) {
+    size_t max = (count - copied) / record_size;
+    uint32_t start;
+    int n = rekernel_events_peek(events, max < EVENTS_READ_MAX ? max : EVENTS_READ_MAX, &start);
+    if (n == 0)
+      break;
+
+    int done = 0;
+    if (rekernel_binary_format == IZERO) {
+      if (rekernel_copy_to_user(buf + copied, events, n * sizeof(struct rekernel_event))) {
+        copied += n * sizeof(struct rekernel_event);
+        done = n;
+      }
+    } else {
+      for (; done < n; done++) {
+        char kmsg[PACKET_SIZE];
+        int len = rekernel_format_event(&events[done], kmsg, sizeof(kmsg) - 1);
+        if (len <= 0)
+          continue;
+        len = strlen(kmsg);
+        kmsg[len++] = '\n';
+        if (!rekernel_copy_to_user(buf + copied, kmsg, len))
+          break;
+        copied += len;
+      }
+    }
+    rekernel_events_commit(start, done);
+    if (done < n)
+      return copied ? copied : -EFAULT;
   }
+  return copied;
 }
 
-static inline void binder_release_entire_buffer(struct binder_proc* proc, struct binder_thread* thread, struct binder_buffer* buffer, bool is_failure) {
-  if (binder_transaction_buffer_release_ver6 == IZERO) {
-    binder_transaction_buffer_release_v6(proc, thread, buffer, 0, is_failure);
-  } else if (binder_transaction_buffer_release_ver5 == IZERO) {
-    binder_size_t off_end_offset = ALIGN(buffer->data_size, sizeof(void*));
-    off_end_offset += buffer->offsets_size;
+// /proc/rekernel/ 下的文件, 4.x 与 5.x 的 file_operations 差异过大, 通过 hook proc_reg_* 实现
+enum rekernel_file_type {
+  REKERNEL_FILE_NONE,
+  REKERNEL_FILE_RING,
+  REKERNEL_FILE_EVENTS,
+  REKERNEL_FILE_ASYNC,
+  REKERNEL_FILE_STATS,
+  REKERNEL_FILE_LATENCY,
+};
+static const char* rekernel_file_name[] = {
+    NULL,
+    "ring",
+    "events",
+    "async",
+    "stats",
+    "latency",
+};
 
-    binder_transaction_buffer_release(proc, thread, buffer, off_end_offset, is_failure);
-  } else if (binder_transaction_buffer_release_ver4 == IZERO) {
-    binder_transaction_buffer_release_v4(proc, buffer, 0, is_failure);
-  } else {
-    binder_transaction_buffer_release_v3(proc, buffer, NULL);
+static struct proc_dir_entry* rekernel_file_entry[ARRAY_SIZE(rekernel_file_name)];
+
+// 按 proc_dir_entry 匹配, 不依赖文件名
+static int rekernel_proc_file(struct file* file) {
+  struct proc_dir_entry* pde = proc_inode_pde(file_inode(file));
+  for (int i = REKERNEL_FILE_NONE + 1; i < ARRAY_SIZE(rekernel_file_name); i++) {
+    if (pde == rekernel_file_entry[i])
+      return i;
   }
+  return REKERNEL_FILE_NONE;
 }
 
-static inline void binder_stats_deleted(enum binder_stat_types type) {
-  atomic_inc(&kvar(binder_stats)->obj_deleted[type]);
+static struct file* rekernel_proc_open(int type, int flags) {
+  char path[32];
+  snprintf(path, sizeof(path), "/proc/rekernel/%s", rekernel_file_name[type]);
+  return filp_open(path, flags, 0);
+}
+
+static bool rekernel_proc_match(struct file* file, uint64_t inode_offset, uint64_t pde_offset, int type) {
+  struct inode* inode = *(struct inode**)((uintptr_t)file + inode_offset);
+  if (is_bad_address(inode) || ((uintptr_t)inode & (sizeof(void*) - 1)))
+    return false;
+  return *(struct proc_dir_entry**)((uintptr_t)inode - pde_offset) == rekernel_file_entry[type];
+}
+
+// 打开 stats 与 latency, 两者的 file->f_inode 与 proc_inode->pde 偏移须唯一且一致
+// 以 O_NONBLOCK 打开其中一个, 仅相差该标志的字段为 f_flags
+static long rekernel_proc_decode(void) {
+  struct file* stats = rekernel_proc_open(REKERNEL_FILE_STATS, O_RDONLY);
+  if (IS_ERR(stats))
+    return PTR_ERR(stats);
+  struct file* latency = rekernel_proc_open(REKERNEL_FILE_LATENCY, O_RDONLY | O_NONBLOCK);
+  if (IS_ERR(latency)) {
+    filp_close(stats, NULL);
+    return PTR_ERR(latency);
+  }
+
+  int inode_found = 0, flags_found = 0;
+  for (uint64_t i = 0; i < PROC_DECODE_FILE_SIZE; i += sizeof(void*)) {
+    for (uint64_t j = sizeof(void*); j <= PROC_DECODE_PDE_SIZE; j += sizeof(void*)) {
+      if (rekernel_proc_match(stats, i, j, REKERNEL_FILE_STATS) && rekernel_proc_match(latency, i, j, REKERNEL_FILE_LATENCY)) {
+        file_inode_offset = i;
+        proc_inode_pde_offset = j;
+        inode_found++;
+      }
+    }
+  }
+  for (uint64_t i = 0; i < PROC_DECODE_FILE_SIZE; i += sizeof(unsigned int)) {
+    unsigned int a = *(unsigned int*)((uintptr_t)stats + i);
+    unsigned int b = *(unsigned int*)((uintptr_t)latency + i);
+    if ((a ^ b) == O_NONBLOCK && (b & O_NONBLOCK) && b < PROC_DECODE_FLAGS_MAX) {
+      file_flags_offset = i;
+      flags_found++;
+    }
+  }
+  filp_close(latency, NULL);
+  filp_close(stats, NULL);
+
+  if (inode_found != 1 || flags_found != 1) {
+    logkm("decode proc file failed: inode=%d flags=%d\n", inode_found, flags_found);
+    file_inode_offset = file_flags_offset = proc_inode_pde_offset = UZERO;
+    return -ENOENT;
+  }
+  logkm("file_inode_offset=0x%llx file_flags_offset=0x%llx proc_inode_pde_offset=0x%llx\n",
+    file_inode_offset, file_flags_offset, proc_inode_pde_offset);
+  return 0;
+}
+
+// 按 ppos 拷贝一段每次读取时重新生成的文本
+static ssize_t rekernel_snapshot_copy(char __user* buf, size_t count, loff_t* ppos, const char* snapshot, size_t len) {
+  ssize_t copied = 0;
+  if (*ppos >= 0 && *ppos < len) {
+    copied = len - *ppos < count ? len - *ppos : count;
+    if (!rekernel_copy_to_user(buf, snapshot + *ppos, copied))
+      return -EFAULT;
+    *ppos += copied;
+  }
+  return copied;
+}
+
+// 每行一个计数: name value, 为上次重置以来的总和
+static ssize_t rekernel_stats_read(char __user* buf, size_t count, loff_t* ppos) {
+  char snapshot[1024];
+  size_t len = 0;
+  for (int i = 0; i < REKERNEL_STAT_MAX && len < sizeof(snapshot); i++) {
+    if (!rekernel_stat_name[i])
+      continue;
+    len += snprintf(snapshot + len, sizeof(snapshot) - len, "%s %llu\n", rekernel_stat_name[i],
+      rekernel_stat_sum(i) - rekernel_stats_base[i]);
+  }
+  if (len > sizeof(snapshot) - 1)
+    len = sizeof(snapshot) - 1;
+  return rekernel_snapshot_copy(buf, count, ppos, snapshot, len);
+}
+
+// 第一行为计数器频率, 之后每个 hook 一行: name total bucket0 ... bucket31
+static ssize_t rekernel_latency_read(char __user* buf, size_t count, loff_t* ppos) {
+  char* snapshot = vmalloc(LATENCY_SNAPSHOT_SIZE);
+  if (!snapshot)
+    return -ENOMEM;
+
+  size_t len = snprintf(snapshot, LATENCY_SNAPSHOT_SIZE, "freq %llu\n", rekernel_cntfrq());
+  for (int type = 0; type < LATENCY_MAX && len < LATENCY_SNAPSHOT_SIZE; type++) {
+    uint64_t buckets[LATENCY_BUCKETS] = { 0 };
+    uint64_t total = 0;
+    for (uint32_t cpu = 0; cpu < rekernel_nr_cpus; cpu++) {
+      for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        buckets[i] += *(volatile uint64_t*)&rekernel_latency_hists[cpu].bucket[type][i];
+      }
+    }
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+      total += buckets[i];
+    }
+    len += snprintf(snapshot + len, LATENCY_SNAPSHOT_SIZE - len, "%s %llu", rekernel_latency_name[type], total);
+    for (int i = 0; i < LATENCY_BUCKETS && len < LATENCY_SNAPSHOT_SIZE; i++) {
+      len += snprintf(snapshot + len, LATENCY_SNAPSHOT_SIZE - len, " %llu", buckets[i]);
+    }
+    if (len < LATENCY_SNAPSHOT_SIZE)
+      len += snprintf(snapshot + len, LATENCY_SNAPSHOT_SIZE - len, "\n");
+  }
+  if (len > LATENCY_SNAPSHOT_SIZE - 1)
+    len = LATENCY_SNAPSHOT_SIZE - 1;
+
+  ssize_t copied = rekernel_snapshot_copy(buf, count, ppos, snapshot, len);
+  vfree(snapshot);
+  return copied;
+}
+
+static ssize_t binder_async_snapshot_read(struct file* file, char __user* buf, size_t count, loff_t* ppos);
+
+static void proc_reg_read_before(hook_fargs4_t* args, void* udata) {
+  struct file* file = (struct file*)args->arg0;
+  char __user* buf = (char __user*)args->arg1;
+  size_t count = (size_t)args->arg2;
+  loff_t* ppos = (loff_t*)args->arg3;
+
+  int type = rekernel_proc_file(file);
+  if (type == REKERNEL_FILE_NONE)
+    return;
+  if (!rekernel_proc_enter()) {
+    args->ret = -ENODEV;
+    args->skip_origin = true;
+    return;
+  }
+  switch (type) {
+  case REKERNEL_FILE_EVENTS:
+    args->ret = rekernel_events_read(file, buf, count);
+    args->skip_origin = true;
+    break;
+  case REKERNEL_FILE_ASYNC:
+    args->ret = binder_async_snapshot_read(file, buf, count, ppos);
+    args->skip_origin = true;
+    break;
+  case REKERNEL_FILE_STATS:
+    args->ret = rekernel_stats_read(buf, count, ppos);
+    args->skip_origin = true;
+    break;
+  case REKERNEL_FILE_LATENCY:
+    args->ret = rekernel_latency_read(buf, count, ppos);
+    args->skip_origin = true;
+    break;
+  default:
+    break;
+  }
+  rekernel_proc_leave();
+}
+
+static void proc_reg_poll_before(hook_fargs2_t* args, void* udata) {
+  struct file* file = (struct file*)args->arg0;
+  struct poll_table_struct* pts = (struct poll_table_struct*)args->arg1;
+
+  int type = rekernel_proc_file(file);
+  if (type == REKERNEL_FILE_NONE || !rekernel_proc_enter())
+    return;
+  switch (type) {
+  case REKERNEL_FILE_RING:
+    poll_wait(file, rekernel_mmap_wait, pts);
+    args->ret = rekernel_mmap_empty() ? 0 : (EPOLLIN | EPOLLRDNORM);
+    args->skip_origin = true;
+    break;
+  case REKERNEL_FILE_EVENTS:
+    poll_wait(file, rekernel_events_wait, pts);
+    args->ret = rekernel_events_empty() ? 0 : (EPOLLIN | EPOLLRDNORM);
+    args->skip_origin = true;
+    break;
+  default:
+    break;
+  }
+  rekernel_proc_leave();
+}
+
+static void proc_reg_mmap_before(hook_fargs2_t* args, void* udata) {
+  struct file* file = (struct file*)args->arg0;
+  struct vm_area_struct* vma = (struct vm_area_struct*)args->arg1;
+
+  int type = rekernel_proc_file(file);
+  if (type == REKERNEL_FILE_NONE || !rekernel_proc_enter())
+    return;
+  switch (type) {
+  case REKERNEL_FILE_RING:
+    args->ret = remap_vmalloc_range(vma, rekernel_mmap_ring, 0);
+    args->skip_origin = true;
+    break;
+  default:
+    break;
+  }
+  rekernel_proc_leave();
+}
+
+// 创建 netlink 服务
+static struct sock* rekernel_netlink;
+static unsigned long rekernel_netlink_unit = UZERO;
+static struct proc_dir_entry* rekernel_dir, * rekernel_unit_entry;
+static const struct file_operations rekernel_unit_fops = {};
+
+static void rekernel_create_file(int type, umode_t mode) {
+  if (rekernel_file_entry[type])
+    return;
+  rekernel_file_entry[type] = proc_create(rekernel_file_name[type], mode, rekernel_dir, &rekernel_unit_fops);
+  if (!rekernel_file_entry[type]) {
+    printk("create rekernel %s failed!\n", rekernel_file_name[type]);
+  }
+}
+
+static void rekernel_create_files(void) {
+  if (!rekernel_dir || rekernel_proc_hooked != IZERO)
+    return;
+
+  if (rekernel_mmap_ring)
+    rekernel_create_file(REKERNEL_FILE_RING, 0600);
+  if (rekernel_events_queue)
+    rekernel_create_file(REKERNEL_FILE_EVENTS, 0400);
+  if (kvar(binder_procs) && kvar(binder_procs_lock))
+    rekernel_create_file(REKERNEL_FILE_ASYNC, 0400);
+  rekernel_create_file(REKERNEL_FILE_STATS, 0400);
+  rekernel_create_file(REKERNEL_FILE_LATENCY, 0400);
+}
+
+static void rekernel_remove_files(void) {
+  for (int i = REKERNEL_FILE_NONE + 1; i < ARRAY_SIZE(rekernel_file_name); i++) {
+    if (rekernel_file_entry[i]) {
+      proc_remove(rekernel_file_entry[i]);
+      rekernel_file_entry[i] = NULL;
+    }
+  }
+}
+
+static int start_rekernel_server(void) {
+  if (rekernel_netlink_unit != UZERO) {
+    return 0;
+  }
+  struct netlink_kernel_cfg rekernel_cfg = {
+    .groups = REKERNEL_GROUP_MAX - 1,
+  };
+
+  for (rekernel_netlink_unit = NETLINK_REKERNEL_MAX; rekernel_netlink_unit >= NETLINK_REKERNEL_MIN; rekernel_netlink_unit--) {
+    rekernel_netlink = netlink_kernel_create(kvar(init_net), rekernel_netlink_unit, &rekernel_cfg);
+    if (rekernel_netlink != NULL) {
+      break;
+    }
+  }
+  if (rekernel_netlink == NULL) {
+    printk("Failed to create Re:Kernel server!\n");
+    return -1;
+  }
+  printk("Created Re:Kernel server! NETLINK UNIT: %d\n", rekernel_netlink_unit);
+
+  if (rekernel_dir) {
+    char buff[32];
+    sprintf(buff, "%d", rekernel_netlink_unit);
+    rekernel_unit_entry = proc_create(buff, 0400, rekernel_dir, &rekernel_unit_fops);
+    if (!rekernel_unit_entry) {
+      printk("create rekernel unit failed!\n");
+    }
+  }
+
+  return 0;
+}
+// 发送 netlink 消息
+static int send_netlink_message(void* msg, uint16_t len) {
+  struct sk_buff* skbuffer;
+  struct nlmsghdr* nlhdr;
+
+  skbuffer = nlmsg_new(len, GFP_ATOMIC);
+  if (!skbuffer) {
+    printk("netlink alloc failure.\n");
+    rekernel_stat_inc(REKERNEL_STAT_ALLOC_FAIL);
+    return -1;
+  }
+
+  nlhdr = nlmsg_put(skbuffer, 0, 0, rekernel_netlink_unit, len, 0);
+  if (!nlhdr) {
+    printk("nlmsg_put failaure.\n");
+    nlmsg_free(skbuffer);
+    return -1;
+  }
+
+  memcpy(nlmsg_data(nlhdr), msg, len);
+  int ret = netlink_unicast(rekernel_netlink, skbuffer, USER_PORT, MSG_DONTWAIT);
+  if (ret < 0)
+    rekernel_stat_inc(REKERNEL_STAT_NETLINK_FAIL);
+  return ret;
+}
+
+static inline void rekernel_event_init(struct rekernel_event* event, int reporttype, int type, bool oneway, pid_t src_pid, uid_t src_uid, pid_t dst_pid, uid_t dst_uid) {
+  event->version = REKERNEL_EVENT_VERSION;
+  event->size = sizeof(struct rekernel_event);
+  event->type = reporttype;
+  event->subtype = type;
+  event->oneway = oneway;
+  event->cpu = rekernel_cpu();
+  event->src_pid = src_pid;
+  event->src_uid = src_uid;
+  event->dst_pid = dst_pid;
+  event->dst_uid = dst_uid;
+  event->timestamp = ktime_get();
+  event->suppressed = 0;
+  event->code = 0;
+  event->iface = 0;
+}
+
+// 文本格式, 与旧版本保持一致
+static int rekernel_format_event(const struct rekernel_event* event, char* buf, size_t size) {
+  int len;
+  switch (event->type) {
+  case BINDER:
+    len = snprintf(buf, size, "type=Binder,bindertype=%s,oneway=%d,from_pid=%d,from=%d,target_pid=%d,target=%d", binder_type[event->subtype], event->oneway, event->src_pid, event->src_uid, event->dst_pid, event->dst_uid);
+    break;
+  case SIGNAL:
+    len = snprintf(buf, size, "type=Signal,signal=%d,killer_pid=%d,killer=%d,dst_pid=%d,dst=%d", event->subtype, event->src_pid, event->src_uid, event->dst_pid, event->dst_uid);
+    break;
+#ifdef CONFIG_NETWORK
+  case NETWORK:
+    len = snprintf(buf, size, "type=Network,target=%d", event->dst_uid);
+    break;
+#endif /* CONFIG_NETWORK */
+  default:
+    return 0;
+  }
+  if (len < 0 || len >= size)
+    return len;
+
+  // 新字段只在非零时输出, 兼容旧的解析方式
+  if (event->suppressed) {
+    len += snprintf(buf + len, size - len, ",suppressed=%u", event->suppressed);
+    if (len >= size)
+      return len;
+  }
+  if (event->type == BINDER && binder_iface != UZERO) {
+    len += snprintf(buf + len, size - len, ",code=%u,iface=0x%08x", event->code, event->iface);
+    if (len >= size)
+      return len;
+  }
+  len += snprintf(buf + len, size - len, ";");
+  return len;
+}
+
+static inline int rekernel_group(int reporttype, int type) {
+  switch (reporttype) {
+  case BINDER:
+    return type == OVERFLOW ? REKERNEL_GROUP_OVERFLOW : REKERNEL_GROUP_BINDER;
+  case SIGNAL:
+    return REKERNEL_GROUP_SIGNAL;
+#ifdef CONFIG_NETWORK
+  case NETWORK:
+    return REKERNEL_GROUP_NETWORK;
+#endif /* CONFIG_NETWORK */
+  default:
+    return REKERNEL_GROUP_NONE;
+  }
+}
+
+// 没有任何消费者时不必构造事件
+static bool rekernel_has_consumer(int group) {
+  if (rekernel_mmap_ring || rekernel_events_queue)
+    return true;
+  if (rekernel_netlink_enabled != IZERO || !rekernel_netlink)
+    return false;
+  return rekernel_unicast == IZERO || netlink_has_listeners(rekernel_netlink, group);
+}
+
+static int rekernel_send_events(const struct rekernel_event* events, int count, int group, gfp_t gfp);
+
+static int rekernel_send_event(const struct rekernel_event* event) {
+  int group = rekernel_group(event->type, event->subtype);
+  if (netlink_has_listeners(rekernel_netlink, group))
+    rekernel_send_events(event, 1, group, GFP_ATOMIC);
+  if (rekernel_unicast != IZERO)
+    return 0;
+
+  if (rekernel_binary_format == IZERO)
+    return send_netlink_message((void*)event, sizeof(struct rekernel_event));
+
+  char binder_kmsg[PACKET_SIZE];
+  int len = rekernel_format_event(event, binder_kmsg, sizeof(binder_kmsg));
+  if (len <= 0)
+    return -1;
+  return send_netlink_message(binder_kmsg, strlen(binder_kmsg));
+}
+
+// 将多条事件打包进同一个 skb, 每条事件一个 nlmsghdr
+// group 为 REKERNEL_GROUP_NONE 时单播给 USER_PORT, 否则只打包该组的事件并组播
+static int rekernel_send_skb(const struct rekernel_event* events, int count, int group, gfp_t gfp) {
+  struct sk_buff* skbuffer;
+  struct nlmsghdr* nlhdr;
+  int packed = 0;
+  // 批量发送的消息带 NLM_F_MULTI, 不附加 NLMSG_DONE, 兼容逐条解析的接收者
+  int flags = count > 1 ? NLM_F_MULTI : 0;
+
+  int max_len = rekernel_binary_format == IZERO ? sizeof(struct rekernel_event) : PACKET_SIZE;
+  skbuffer = alloc_skb(nlmsg_total_size(max_len) * count, gfp);
+  if (!skbuffer) {
+    printk("netlink alloc failure.\n");
+    rekernel_stat_inc(REKERNEL_STAT_ALLOC_FAIL);
+    return -1;
+  }
+
+  for (int i = 0; i < count; i++) {
+    if (group != REKERNEL_GROUP_NONE && rekernel_group(events[i].type, events[i].subtype) != group)
+      continue;
+    if (rekernel_binary_format == IZERO) {
+      nlhdr = nlmsg_put(skbuffer, 0, 0, rekernel_netlink_unit, sizeof(struct rekernel_event), flags);
+      if (nlhdr) {
+        memcpy(nlmsg_data(nlhdr), &events[i], sizeof(struct rekernel_event));
+      }
+    } else {
+      char binder_kmsg[PACKET_SIZE];
+      int len = rekernel_format_event(&events[i], binder_kmsg, sizeof(binder_kmsg));
+      if (len <= 0)
+        continue;
+      len = strlen(binder_kmsg);
+      nlhdr = nlmsg_put(skbuffer, 0, 0, rekernel_netlink_unit, len, flags);
+      if (nlhdr) {
+        memcpy(nlmsg_data(nlhdr), binder_kmsg, len);
+      }
+    }
+    if (!nlhdr) {
+      printk("nlmsg_put failaure.\n");
+      nlmsg_free(skbuffer);
+      return -1;
+    }
+    packed++;
+  }
+
+  if (!packed) {
+    nlmsg_free(skbuffer);
+    return 0;
+  }
+  int ret;
+  if (group != REKERNEL_GROUP_NONE)
+    ret = netlink_broadcast(rekernel_netlink, skbuffer, 0, group, gfp);
+  else
+    ret = netlink_unicast(rekernel_netlink, skbuffer, USER_PORT, MSG_DONTWAIT);
+  if (ret < 0)
+    rekernel_stat_inc(REKERNEL_STAT_NETLINK_FAIL);
+  return ret;
+}
+
+// hook 中发送时 gfp 为 GFP_ATOMIC, rekernel 线程中为 GFP_KERNEL, 每个 skb 不超过 EVENT_SKB_MAX
+static int rekernel_send_events(const struct rekernel_event* events, int count, int group, gfp_t gfp) {
+  int max_len = rekernel_binary_format == IZERO ? sizeof(struct rekernel_event) : PACKET_SIZE;
+  int per_skb = EVENT_SKB_MAX / nlmsg_total_size(max_len);
+  int ret = 0;
+  for (int i = 0; i < count; i += per_skb) {
+    int rc = rekernel_send_skb(events + i, count - i < per_skb ? count - i : per_skb, group, gfp);
+    if (rc < 0)
+      ret = rc;
+  }
+  return ret;
+}
+
+static void rekernel_netlink_send(const struct rekernel_event* events, int count) {
+  if (rekernel_unicast == IZERO) {
+    rekernel_send_events(events, count, REKERNEL_GROUP_NONE, GFP_KERNEL);
+  }
+
+  unsigned int groups = 0;
+  for (int i = 0; i < count; i++) {
+    groups |= 1U << rekernel_group(events[i].type, events[i].subtype);
+  }
+  for (int group = REKERNEL_GROUP_NONE + 1; group < REKERNEL_GROUP_MAX; group++) {
+    if ((groups & (1U << group)) && netlink_has_listeners(rekernel_netlink, group)) {
+      rekernel_send_events(events, count, group, GFP_KERNEL);
+    }
+  }
+}
+
+// 多生产者单消费者: 生产者用 cmpxchg 占位, 写完后发布 seq, 中断嵌套时依然安全
+struct rekernel_ring {
+  uint32_t head;
+  uint32_t tail;
+  uint32_t seq[EVENT_RING_SIZE];
+  struct rekernel_event events[EVENT_RING_SIZE];
+} __attribute__((aligned(64)));
+static struct rekernel_ring* rekernel_rings;
+static struct task_struct* rekernel_worker_task;
+static uint64_t rekernel_ring_dropped;
+// 有新任务时置位, 线程空闲时据此决定能否无限期睡眠, 避免丢失唤醒
+static uint32_t rekernel_worker_pending;
+static wait_queue_head_t rekernel_worker_wait;
+
+static void rekernel_worker_wake(void) {
+  smp_store_release(&rekernel_worker_pending, 1);
+  if (rekernel_worker_task)
+    wake_up_process(rekernel_worker_task);
+}
+
+static bool rekernel_ring_push(const struct rekernel_event* event) {
+  struct rekernel_ring* ring = &rekernel_rings[event->cpu & (rekernel_nr_cpus - 1)];
+  uint32_t head;
+  do {
+    head = ring->head;
+    if (head - smp_load_acquire(&ring->tail) >= EVENT_RING_SIZE)
+      return false;
+  } while (cmpxchg_u32(&ring->head, head, head + 1) != head);
+
+  ring->events[head & EVENT_RING_MASK] = *event;
+  smp_store_release(&ring->seq[head & EVENT_RING_MASK], head + 1);
+
+  // 积攒够一批后提前唤醒, 不必等到下一个周期
+  if (head + 1 - ring->tail == rekernel_batch)
+    rekernel_worker_wake();
+  return true;
+}
+
+static bool rekernel_ring_pop(struct rekernel_ring* ring, struct rekernel_event* event) {
+  uint32_t tail = ring->tail;
+  if (smp_load_acquire(&ring->seq[tail & EVENT_RING_MASK]) != tail + 1)
+    return false;
+
+  *event = ring->events[tail & EVENT_RING_MASK];
+  smp_store_release(&ring->tail, tail + 1);
+  return true;
+}
+
+static void rekernel_flush(void) {
+  struct rekernel_event events[EVENT_BATCH_MAX];
+  int count = 0;
+
+  for (uint32_t cpu = 0; cpu < rekernel_nr_cpus; cpu++) {
+    struct rekernel_ring* ring = &rekernel_rings[cpu];
+    while (rekernel_ring_pop(ring, &events[count])) {
+      if (++count >= rekernel_batch) {
+        rekernel_netlink_send(events, count);
+        count = 0;
+      }
+    }
+  }
+  if (count) {
+    rekernel_netlink_send(events, count);
+  }
+}
+
+static void rekernel_frozen_recheck(void);
+
+#ifdef CONFIG_NETWORK
+static void rekernel_net_deadline_scan(void);
+static void rekernel_net_nf_update(void);
+#endif /* CONFIG_NETWORK */
+static void binder_reclaim_flush(void);
+static void binder_compact_pending(void);
+// prepare_to_wait_event 先设置睡眠状态再检查, 之后置位 pending 再唤醒一定能唤醒
+static void rekernel_thread_idle(wait_queue_head_t* wq_head, uint32_t* pending) {
+  struct wait_queue_entry wait;
+
+  init_wait_entry(&wait, 0);
+  prepare_to_wait_event(wq_head, &wait, TASK_INTERRUPTIBLE);
+  if (!smp_load_acquire(pending) && !kthread_should_stop())
+    schedule();
+  finish_wait(wq_head, &wait);
+}
+
+static int rekernel_worker(void* data) {
+  while (!kthread_should_stop()) {
+    xchg_u32(&rekernel_worker_pending, 0);
+    rekernel_flush();
+    rekernel_frozen_recheck();
+#ifdef CONFIG_NETWORK
+    rekernel_net_nf_update();
+    rekernel_net_deadline_scan();
+#endif /* CONFIG_NETWORK */
+    binder_compact_pending();
+    binder_reclaim_flush();
+    // 同步发送时没有周期任务, 空闲时一直睡眠到被唤醒
+    long timeout = rekernel_flush_ms == UZERO ? MAX_SCHEDULE_TIMEOUT : rekernel_flush_jiffies;
+#ifdef CONFIG_NETWORK
+    if (rekernel_net_backlog != UZERO && rekernel_net_deadline != UZERO && rekernel_net_deadline_jiffies < timeout) {
+      timeout = rekernel_net_deadline_jiffies;
+    }
+#endif /* CONFIG_NETWORK */
+    if (timeout == MAX_SCHEDULE_TIMEOUT)
+      rekernel_thread_idle(&rekernel_worker_wait, &rekernel_worker_pending);
+    else if (timeout)
+      schedule_timeout_interruptible(timeout);
+  }
+  rekernel_flush();
+  binder_reclaim_flush();
+  return 0;
+}
+
+static void rekernel_submit_event(const struct rekernel_event* event) {
+  rekernel_stat_inc(REKERNEL_STAT_REPORT + rekernel_group(event->type, event->subtype));
+  if (rekernel_mmap_ring) {
+    rekernel_mmap_push(event);
+  }
+  if (rekernel_events_queue) {
+    rekernel_events_push(event);
+  }
+  if (rekernel_netlink_enabled != IZERO || !rekernel_netlink) {
+    return;
+  }
+  if (rekernel_flush_ms == UZERO || !rekernel_worker_task) {
+    rekernel_send_event(event);
+  } else if (!rekernel_ring_push(event)) {
+    rekernel_ring_dropped++;
+    rekernel_stat_inc(REKERNEL_STAT_QUEUE_DROPPED);
+  }
+}
+
+struct rekernel_uid_slot {
+  uint32_t key; // uid + 1, 0 为空
+  uint32_t notified; // 本次冻结周期内已报告
+  uint32_t net_last; // 上一个网络事件的 jiffies
+  uint32_t net_pending; // 积压开始时的 jiffies, 0 为无积压
+  uint32_t async_pressure; // 有进程的异步缓冲区压力已报告, 解冻时清理 binder_pressure_slots
+  uint32_t suppressed[REKERNEL_GROUP_MAX];
+  uint64_t bucket[REKERNEL_GROUP_MAX]; // 高 32 位: 令牌, 低 32 位: 上次补充时的 jiffies
+};
+static struct rekernel_uid_slot rekernel_uid_slots[UID_SLOT_SIZE];
+
+static struct rekernel_uid_slot* rekernel_uid_slot(uid_t uid, bool create) {
+  uint32_t key = uid + 1;
+  uint32_t hash = (key * 0x9E3779B1u) >> (32 - UID_SLOT_BITS);
+  for (int i = 0; i < UID_SLOT_PROBE; i++) {
+    struct rekernel_uid_slot* slot = &rekernel_uid_slots[(hash + i) & (UID_SLOT_SIZE - 1)];
+    uint32_t cur = smp_load_acquire(&slot->key);
+    if (cur == 0) {
+      if (!create)
+        return NULL;
+      cur = cmpxchg_u32(&slot->key, 0, key);
+    }
+    if (cur == 0 || cur == key)
+      return slot;
+  }
+  // 表满时不记录状态
+  return NULL;
+}
+
+static inline unsigned long rekernel_jiffies(void) {
+  return *(volatile u64*)kvar(jiffies_64);
+}
+
+// 令牌桶, 无锁更新, 首次使用时桶是满的
+static bool rekernel_take_token(struct rekernel_uid_slot* slot, int group) {
+  uint64_t max = rekernel_burst * TOKEN_SCALE;
+  uint32_t now = rekernel_jiffies();
+  uint64_t old, new;
+  do {
+    old = smp_load_acquire(&slot->bucket[group]);
+    uint64_t tokens = max;
+    if (old) {
+      uint32_t elapsed = now - (uint32_t)old;
+      tokens = (old >> 32) + (uint64_t)elapsed * rekernel_rate * TOKEN_SCALE / rekernel_hz;
+      if (tokens > max)
+        tokens = max;
+    }
+    if (tokens < TOKEN_SCALE)
+      return false;
+    new = ((tokens - TOKEN_SCALE) << 32) | now;
+  } while (cmpxchg_u64(&slot->bucket[group], old, new) != old);
+  return true;
+}
+
+// 返回 false 表示事件被限流, 否则通过 suppressed 返回此前被限流的数量
+static bool rekernel_throttle(uid_t uid, int group, uint32_t* suppressed) {
+  *suppressed = 0;
+  if (rekernel_rate == UZERO && rekernel_epoch == UZERO) {
+    // 不限流时仍需带出并清零其他途径计入的数量, 如网络事件的窗口合并
+    struct rekernel_uid_slot* slot = rekernel_uid_slot(uid, false);
+    if (slot && smp_load_acquire(&slot->suppressed[group]))
+      *suppressed = xchg_u32(&slot->suppressed[group], 0);
+    return true;
+  }
+
+  struct rekernel_uid_slot* slot = rekernel_uid_slot(uid, true);
+  if (!slot)
+    return true;
+  if (rekernel_epoch == IZERO && smp_load_acquire(&slot->notified))
+    goto suppress;
+  if (rekernel_rate != UZERO && !rekernel_take_token(slot, group))
+    goto suppress;
+  // 并发时只有一个事件能标记 notified
+  if (rekernel_epoch == IZERO && xchg_u32(&slot->notified, 1))
+    goto suppress;
+
+  *suppressed = xchg_u32(&slot->suppressed[group], 0);
+  return true;
+
+suppress:
+  add_return_u32(&slot->suppressed[group], 1);
+  rekernel_stat_inc(REKERNEL_STAT_THROTTLED);
+  return false;
+}
+
+// 异步缓冲区已报告压力的进程, 同一应用的多个进程分别报告与恢复
+struct binder_pressure_slot {
+  uint32_t pid; // 0 为空
+  uint32_t uid;
+};
+static struct binder_pressure_slot binder_pressure_slots[ASYNC_PRESSURE_SIZE];
+
+// 释放后探测链会断开, 查找时总是探测全部位置
+static struct binder_pressure_slot* binder_pressure_slot(pid_t pid, bool create) {
+  uint32_t hash = ((uint32_t)pid * 0x9E3779B1u) >> (32 - ASYNC_PRESSURE_BITS);
+  for (int i = 0; i < ASYNC_PRESSURE_PROBE; i++) {
+    struct binder_pressure_slot* slot = &binder_pressure_slots[(hash + i) & (ASYNC_PRESSURE_SIZE - 1)];
+    if (smp_load_acquire(&slot->pid) == (uint32_t)pid)
+      return slot;
+  }
+  if (!create)
+    return NULL;
+  for (int i = 0; i < ASYNC_PRESSURE_PROBE; i++) {
+    struct binder_pressure_slot* slot = &binder_pressure_slots[(hash + i) & (ASYNC_PRESSURE_SIZE - 1)];
+    uint32_t cur = cmpxchg_u32(&slot->pid, 0, pid);
+    if (cur == 0 || cur == (uint32_t)pid)
+      return slot;
+  }
+  return NULL;
+}
+
+static inline void binder_pressure_release(struct binder_pressure_slot* slot) {
+  smp_store_release(&slot->uid, 0);
+  smp_store_release(&slot->pid, 0);
+}
+
+// 解冻后该应用的所有进程重新开始, 只在有进程报告过时扫描
+static void binder_pressure_clear(uid_t uid) {
+  for (int i = 0; i < ASYNC_PRESSURE_SIZE; i++) {
+    struct binder_pressure_slot* slot = &binder_pressure_slots[i];
+    if (smp_load_acquire(&slot->pid) && smp_load_acquire(&slot->uid) == uid)
+      binder_pressure_release(slot);
+  }
+}
+
+// 解冻后开始新的冻结周期
+static void rekernel_uid_thawed(uid_t uid) {
+  struct rekernel_uid_slot* slot = rekernel_uid_slot(uid, false);
+  if (!slot)
+    return;
+
+  // 解冻后应用会自行读取积压的数据
+  if (slot->net_pending)
+    smp_store_release(&slot->net_pending, 0);
+  if (slot->async_pressure && xchg_u32(&slot->async_pressure, 0))
+    binder_pressure_clear(uid);
+  if (rekernel_epoch == IZERO && slot->notified)
+    smp_store_release(&slot->notified, 0);
+}
+
+// 遍历 binder_procs 重新确认冻结状态, mask 为 NULL 时检查所有 uid
+// frozen 为 NULL 时直接置位 rekernel_frozen_uids, 否则只记录到 frozen 中
+static void rekernel_frozen_scan(const uint64_t* mask, uint64_t* frozen) {
+  mutex_lock(kvar(binder_procs_lock));
+  struct hlist_node* node;
+  for (node = kvar(binder_procs)->first; node; node = node->next) {
+    struct binder_proc* proc = container_of(node, struct binder_proc, proc_node);
+    struct task_struct* tsk = proc->tsk;
+    if (!tsk)
+      continue;
+    uid_t uid = task_uid(tsk).val % PER_USER_RANGE;
+    if (uid < MIN_USERAPP_UID)
+      continue;
+    uint32_t index = uid - MIN_USERAPP_UID;
+    if (mask && !((mask[index / 64] >> (index % 64)) & 1))
+      continue;
+    if (!frozen_task_group(tsk))
+      continue;
+    if (frozen)
+      frozen[index / 64] |= 1UL << (index % 64);
+    else
+      rekernel_uid_mark(rekernel_frozen_uids, uid);
+  }
+  mutex_unlock(kvar(binder_procs_lock));
+}
+
+// 同一 uid 可能有多个进程分别冻结, 解冻时先扫描仍冻结的 uid, 只清除已全部解冻的
+// 扫描期间位图保持置位, 不会漏报仍冻结的进程
+static void rekernel_frozen_recheck(void) {
+  static uint64_t recheck[FROZEN_UID_WORDS], frozen[FROZEN_UID_WORDS];
+
+  if (rekernel_frozen_bitmap != IZERO || !xchg_u32(&rekernel_frozen_pending_any, 0))
+    return;
+
+  for (int i = 0; i < FROZEN_UID_WORDS; i++) {
+    recheck[i] = xchg_u64(&rekernel_frozen_pending[i], 0);
+    xchg_u64(&rekernel_frozen_entered[i], 0);
+  }
+  memset(frozen, 0, sizeof(frozen));
+  rekernel_frozen_scan(recheck, frozen);
+
+  for (int i = 0; i < FROZEN_UID_WORDS; i++) {
+    uint64_t clear = recheck[i] & ~frozen[i];
+    if (!clear)
+      continue;
+    andnot_u64(&rekernel_frozen_uids[i], clear);
+    // 扫描之后才进入冻结的 uid 重新置位
+    uint64_t entered = xchg_u64(&rekernel_frozen_entered[i], 0) & clear;
+    if (entered)
+      or_u64(&rekernel_frozen_uids[i], entered);
+  }
+}
+
+static void rekernel_compact_request(uid_t uid, uint32_t any) {
+  if (uid)
+    rekernel_uid_mark(rekernel_compact_pending, uid);
+  uint32_t old = smp_load_acquire(&rekernel_compact_pending_any);
+  if (old >= any)
+    return;
+  if (cmpxchg_u32(&rekernel_compact_pending_any, old, any) == old && !old)
+    rekernel_worker_wake();
+}
+
+static void rekernel_uid_frozen(uid_t uid) {
+  rekernel_uid_mark(rekernel_frozen_uids, uid);
+  rekernel_uid_mark(rekernel_frozen_entered, uid);
+#ifdef CONFIG_NETWORK
+  if (rekernel_net_ondemand == IZERO && !smp_load_acquire(&rekernel_net_nf_registered))
+    rekernel_worker_wake();
+#endif /* CONFIG_NETWORK */
+  if (rekernel_compact_on_freeze == IZERO)
+    rekernel_compact_request(uid, 1);
+}
+
+static void rekernel_uid_thaw(uid_t uid) {
+  rekernel_uid_thawed(uid);
+
+  rekernel_uid_mark(rekernel_frozen_pending, uid);
+  if (!xchg_u32(&rekernel_frozen_pending_any, 1))
+    rekernel_worker_wake();
+}
+
+static void binder_txn_invalidate(pid_t tgid);
+
+static void cgroup_enter_frozen_before(hook_fargs0_t* args, void* udata) {
+  rekernel_uid_frozen(task_uid(current).val);
+}
+
+// cgroupv2_freeze, 离开 frozen 后如果未再次设置 JOBCTL_TRAP_FREEZE 则已解冻
+static void cgroup_leave_frozen_after(hook_fargs1_t* args, void* udata) {
+  // 离开冻结 (包括被杀死) 后 async_todo 可能被消费, 消息随之释放
+  binder_txn_invalidate(task_tgid(current));
+  if (!jobctl_frozen(current))
+    rekernel_uid_thaw(task_uid(current).val);
+}
+
+// cgroupv1_freeze, 进入 __refrigerator 即冻结, 返回即已解冻
+static void __refrigerator_before(hook_fargs1_t* args, void* udata) {
+  rekernel_uid_frozen(task_uid(current).val);
+}
+
+static void __refrigerator_after(hook_fargs1_t* args, void* udata) {
+  binder_txn_invalidate(task_tgid(current));
+  rekernel_uid_thaw(task_uid(current).val);
+}
+
+static inline uint32_t binder_iface_fnv(uint32_t hash, uint32_t c) {
+  return (hash ^ c) * 0x01000193;
+}
+
+// 过滤表与事件都需要接口描述符时才读取消息头
+static inline bool binder_iface_wanted(void) {
+  return binder_iface != UZERO || binder_filter_active != UZERO;
+}
+
+// Parcel 头部: strict mode (4), Android 10 起 work source (4), Android 11 起 SYST/VNDR 标记 (4), 之后为 String16 描述符
+// 按 12, 8, 4 的顺序尝试长度字段, 要求以 0 结尾且全部为可打印 ASCII, 返回 FNV-1a 哈希
+static uint32_t binder_interface_hash(struct binder_transaction* t) {
+  if (!binder_alloc_copy_from_buffer)
+    return 0;
+  struct binder_buffer* buffer = binder_transaction_buffer(t);
+  struct binder_proc* proc = binder_transaction_to_proc(t);
+  // trace 时 buffer 尚未分配
+  if (!buffer || !proc)
+    return 0;
+
+  uint8_t header[BINDER_IFACE_HEADER];
+  size_t size = buffer->data_size < sizeof(header) ? buffer->data_size : sizeof(header);
+  if (size < 8 || binder_alloc_copy_from_buffer(binder_proc_alloc(proc), header, buffer, 0, size))
+    return 0;
+
+  for (int offset = 12; offset >= 4; offset -= 4) {
+    if (offset + 4 > size)
+      continue;
+    int32_t len = *(int32_t*)(header + offset);
+    if (len <= 0 || len > BINDER_IFACE_MAX || offset + 4 + (len + 1) * 2 > size)
+      continue;
+    uint16_t* chars = (uint16_t*)(header + offset + 4);
+    if (chars[len])
+      continue;
+
+    uint32_t hash = BINDER_IFACE_FNV_BASIS;
+    int i;
+    for (i = 0; i < len; i++) {
+      if (chars[i] < 0x20 || chars[i] > 0x7E)
+        break;
+      hash = binder_iface_fnv(hash, chars[i]);
+    }
+    if (i == len)
+      return hash ? hash : 1;
+  }
+  return 0;
+}
+
+struct binder_filter_entry {
+  uint32_t iface;
+  int32_t code; // -1: 任意
+  int32_t uid;  // appid, -1: 任意
+  uint16_t used;
+  uint16_t deny;
+};
+
+struct binder_filter {
+  uint32_t count;
+  uint32_t deny; // 没有规则匹配时的动作
+  struct binder_filter_entry entries[BINDER_FILTER_SIZE];
+};
+
+// 双缓冲, 与合并策略相同
+static struct binder_filter binder_filters[2];
+static uint32_t binder_filter_refs[2];
+static uint32_t binder_filter_active_index;
+
+static inline uint32_t binder_filter_hash(uint32_t iface, int32_t code, int32_t uid) {
+  uint32_t key = iface ^ ((uint32_t)code * 0x85EBCA6Bu) ^ ((uint32_t)uid * 0xC2B2AE35u);
+  return (key * 0x9E3779B1u) >> (32 - BINDER_FILTER_BITS);
+}
+
+static struct binder_filter_entry* binder_filter_find(struct binder_filter* filter, uint32_t iface, int32_t code, int32_t uid, bool create) {
+  uint32_t hash = binder_filter_hash(iface, code, uid);
+  for (uint32_t i = 0; i < BINDER_FILTER_SIZE; i++) {
+    struct binder_filter_entry* entry = &filter->entries[(hash + i) & (BINDER_FILTER_SIZE - 1)];
+    if (!entry->used)
+      return create ? entry : NULL;
+    if (entry->iface == iface && entry->code == code && entry->uid == uid)
+      return entry;
+  }
+  return NULL;
+}
+
+// 依次查找 (iface, code, uid), (iface, code, *), (iface, *, uid), (iface, *, *), 接口未知时总是报告
+static bool binder_filter_allowed(uid_t uid, unsigned int code, uint32_t iface) {
+  if (binder_filter_active == UZERO || !iface)
+    return true;
+
+  uint32_t index;
+  for (;;) {
+    index = smp_load_acquire(&binder_filter_active_index);
+    add_return_u32(&binder_filter_refs[index], 1);
+    smp_mb();
+    if (smp_load_acquire(&binder_filter_active_index) == index)
+      break;
+    add_return_u32(&binder_filter_refs[index], -1);
+  }
+
+  struct binder_filter* filter = &binder_filters[index];
+  int32_t appid = uid % PER_USER_RANGE;
+  struct binder_filter_entry* entry = binder_filter_find(filter, iface, code, appid, false);
+  if (!entry)
+    entry = binder_filter_find(filter, iface, code, -1, false);
+  if (!entry)
+    entry = binder_filter_find(filter, iface, -1, appid, false);
+  if (!entry)
+    entry = binder_filter_find(filter, iface, -1, -1, false);
+  bool allowed = entry ? !entry->deny : !filter->deny;
+  add_return_u32(&binder_filter_refs[index], -1);
+  return allowed;
+}
+
+// 描述符或 0x 开头的哈希, 与 binder_interface_hash 一致, 0 保留为未知
+static long binder_iface_parse(const char* value, uint32_t* iface) {
+  uint32_t hash;
+  if (value[0] == '0' && (value[1] == 'x' || value[1] == 'X')) {
+    if (kstrtouint(value, 16, &hash))
+      return -EINVAL;
+  } else {
+    hash = BINDER_IFACE_FNV_BASIS;
+    for (const char* c = value; *c; c++) {
+      hash = binder_iface_fnv(hash, (uint8_t)*c);
+    }
+  }
+  *iface = hash ? hash : 1;
+  return 0;
+}
+
+// 规则格式: allow|deny:iface:code[:uid], iface 为描述符或 0x 开头的哈希, code 与 uid 为 * 表示任意
+// allow|deny:*:* 设置没有规则匹配时的动作, 同一个键以第一条规则为准
+static long binder_filter_parse_rule(char* value, struct binder_filter* filter) {
+  char* field[4] = { value };
+  int n = 1;
+  for (char* p = value; *p; p++) {
+    if (*p != ':')
+      continue;
+    if (n >= ARRAY_SIZE(field))
+      return -EINVAL;
+    *p = '\0';
+    field[n++] = p + 1;
+  }
+  if (n < 3)
+    return -EINVAL;
+
+  bool deny;
+  if (!strcmp(field[0], "allow"))
+    deny = false;
+  else if (!strcmp(field[0], "deny"))
+    deny = true;
+  else
+    return -EINVAL;
+
+  if (!strcmp(field[1], "*")) {
+    if (strcmp(field[2], "*") || (n > 3 && strcmp(field[3], "*")))
+      return -EINVAL;
+    filter->deny = deny;
+    return 0;
+  }
+
+  uint32_t iface;
+  if (binder_iface_parse(field[1], &iface))
+    return -EINVAL;
+
+  int code = -1, uid = -1;
+  if (strcmp(field[2], "*")) {
+    if (kstrtoint(field[2], 0, &code))
+      return -EINVAL;
+    if (code < 0)
+      return -ERANGE;
+  }
+  if (n > 3 && strcmp(field[3], "*")) {
+    if (kstrtoint(field[3], 0, &uid))
+      return -EINVAL;
+    if (uid < 0)
+      return -ERANGE;
+    uid %= PER_USER_RANGE;
+  }
+
+  struct binder_filter_entry* entry = binder_filter_find(filter, iface, code, uid, true);
+  if (entry->used)
+    return 0;
+  if (filter->count >= BINDER_FILTER_MAX)
+    return -E2BIG;
+  entry->iface = iface;
+  entry->code = code;
+  entry->uid = uid;
+  entry->deny = deny;
+  entry->used = 1;
+  filter->count++;
+  return 0;
+}
+
+static long binder_set_filter(char* value) {
+  uint32_t index = smp_load_acquire(&binder_filter_active_index) ^ 1;
+  struct binder_filter* filter = &binder_filters[index];
+
+  // 等待仍在使用旧表的读者
+  smp_mb();
+  while (smp_load_acquire(&binder_filter_refs[index]))
+    schedule_timeout_interruptible(1);
+
+  memset(filter, 0, sizeof(*filter));
+  if (strcmp(value, "off")) {
+    char* p = value;
+    while (*p) {
+      char* rule = p;
+      while (*p && *p != ';')
+        p++;
+      if (*p)
+        *p++ = '\0';
+      if (!*rule)
+        continue;
+      long rc = binder_filter_parse_rule(rule, filter);
+      if (rc < 0)
+        return rc;
+    }
+  }
+  smp_store_release(&binder_filter_active_index, index);
+  binder_filter_active = filter->count || filter->deny ? IZERO : UZERO;
+  return 0;
+}
+
+// 自动解冻租约, 热路径只占位与计数, 由 rekernel_thaw 线程读写 cgroup.freeze.
+// 不与 rekernel 线程共用, 解冻不排在批量发送与整理之后, 读写 cgroup 文件也不阻塞事件发送
+static struct task_struct* binder_thaw_task;
+static uint32_t binder_thaw_wake_pending;
+static wait_queue_head_t binder_thaw_wait;
+
+static void binder_thaw_wake(void) {
+  smp_store_release(&binder_thaw_wake_pending, 1);
+  if (binder_thaw_task)
+    wake_up_process(binder_thaw_task);
+}
+
+enum binder_thaw_state {
+  THAW_FREE,
+  THAW_BUSY,    // 正在占位或由 rekernel_thaw 线程处理
+  THAW_REQUEST, // 等待 rekernel_thaw 线程检查并解冻
+  THAW_THAWING, // rekernel_thaw 线程正在解冻
+  THAW_ACTIVE,  // 已解冻, 等待回复或到期
+  THAW_RELEASE, // 已回复, 等待重新冻结
+  THAW_CANCEL,  // 守护进程或其他进程接管, 不再重新冻结
+};
+
+struct binder_thaw_caller {
+  uint32_t pid;     // 调用方进程, 0 为空
+  uint32_t pending; // 租约期间发出且尚未回复的同步消息
+};
+
+struct binder_thaw_lease {
+  uint32_t state;
+  pid_t pid;
+  uid_t uid;
+  uint32_t expires;  // jiffies
+  uint32_t overflow; // 调用方多于 THAW_CALLERS 个, 无法判断是否全部回复
+  struct binder_thaw_caller callers[THAW_CALLERS];
+  struct rekernel_event event; // 占位时的 transaction 事件, 无法解冻或放弃租约时原样报告
+};
+static struct binder_thaw_lease binder_thaw_leases[THAW_LEASE_MAX];
+static uint32_t binder_thaw_nr; // 非空闲的租约数
+
+static struct binder_thaw_lease* binder_thaw_find(pid_t pid) {
+  for (int i = 0; i < THAW_LEASE_MAX; i++) {
+    struct binder_thaw_lease* lease = &binder_thaw_leases[i];
+    uint32_t state = smp_load_acquire(&lease->state);
+    if (state != THAW_FREE && state != THAW_BUSY && state != THAW_CANCEL && lease->pid == pid)
+      return lease;
+  }
+  return NULL;
+}
+
+// 返回 true 表示事件交由 rekernel_thaw 线程报告, 并发时同一进程可能占用两个租约, 第二个会因 cgroup.freeze 已为 0 而退回普通报告
+static bool binder_thaw_request(const struct rekernel_event* event) {
+  if (!binder_thaw_task)
+    return false;
+  struct binder_thaw_lease* lease = binder_thaw_find(event->dst_pid);
+  if (lease)
+    return smp_load_acquire(&lease->state) == THAW_REQUEST;
+
+  for (int i = 0; i < THAW_LEASE_MAX; i++) {
+    lease = &binder_thaw_leases[i];
+    if (smp_load_acquire(&lease->state) != THAW_FREE || cmpxchg_u32(&lease->state, THAW_FREE, THAW_BUSY) != THAW_FREE)
+      continue;
+    add_return_u32(&binder_thaw_nr, 1);
+    lease->pid = event->dst_pid;
+    lease->uid = event->dst_uid;
+    lease->overflow = 0;
+    memset(lease->callers, 0, sizeof(lease->callers));
+    lease->event = *event;
+    smp_store_release(&lease->state, THAW_REQUEST);
+    binder_thaw_wake();
+    return true;
+  }
+  return false;
+}
+
+// 租约之前的调用不会出现在表中, 其回复不影响计数
+static struct binder_thaw_caller* binder_thaw_caller(struct binder_thaw_lease* lease, pid_t caller, bool create) {
+  for (int i = 0; i < THAW_CALLERS; i++) {
+    struct binder_thaw_caller* entry = &lease->callers[i];
+    uint32_t pid = smp_load_acquire(&entry->pid);
+    if (pid == (uint32_t)caller && (create || smp_load_acquire(&entry->pending)))
+      return entry;
+    if (!pid && create && cmpxchg_u32(&entry->pid, 0, caller) == 0)
+      return entry;
+  }
+  return NULL;
+}
+
+static bool binder_thaw_pending(struct binder_thaw_lease* lease) {
+  if (smp_load_acquire(&lease->overflow))
+    return true;
+  for (int i = 0; i < THAW_CALLERS; i++) {
+    if (smp_load_acquire(&lease->callers[i].pending))
+      return true;
+  }
+  return false;
+}
+
+// 按调用方进程配对同步消息与回复, 租约期间的消息全部回复后提前重新冻结
+static void binder_thaw_track(pid_t pid, pid_t caller, bool reply) {
+  struct binder_thaw_lease* lease = binder_thaw_find(pid);
+  if (!lease)
+    return;
+  struct binder_thaw_caller* entry = binder_thaw_caller(lease, caller, !reply);
+  if (!reply) {
+    if (entry)
+      add_return_u32(&entry->pending, 1);
+    else
+      smp_store_release(&lease->overflow, 1);
+    return;
+  }
+  if (!entry)
+    return;
+
+  uint32_t pending;
+  do {
+    pending = smp_load_acquire(&entry->pending);
+    if (!pending)
+      return;
+  } while (cmpxchg_u32(&entry->pending, pending, pending - 1) != pending);
+  if (pending != 1 || binder_thaw_pending(lease))
+    return;
+  uint32_t state = smp_load_acquire(&lease->state);
+  if ((state == THAW_THAWING || state == THAW_ACTIVE) && cmpxchg_u32(&lease->state, state, THAW_RELEASE) == state)
+    binder_thaw_wake();
+}
+
+// 取消已解冻的租约, pid 为 0 时取消该 uid 的全部租约. 尚未解冻的租约仍由 rekernel_thaw 线程检查冻结状态
+static void binder_thaw_cancel(uid_t uid, pid_t pid) {
+  for (int i = 0; i < THAW_LEASE_MAX; i++) {
+    struct binder_thaw_lease* lease = &binder_thaw_leases[i];
+    uint32_t state = smp_load_acquire(&lease->state);
+    if (state != THAW_THAWING && state != THAW_ACTIVE && state != THAW_RELEASE)
+      continue;
+    if (lease->uid == uid && (!pid || lease->pid == pid) && cmpxchg_u32(&lease->state, state, THAW_CANCEL) == state)
+      binder_thaw_wake();
+  }
+}
+
+// 解析 "/uid_<uid>" 或 "/pid_<pid>" 一级, 成功时移到下一级
+static bool binder_cgroup_id(const char** path, const char* prefix, int* id) {
+  const char* p = *path;
+  if (strncmp(p, prefix, 5) || p[5] < '0' || p[5] > '9')
+    return false;
+  int val = 0;
+  for (p += 5; *p >= '0' && *p <= '9'; p++)
+    val = val * 10 + (*p - '0');
+  *id = val;
+  *path = p;
+  return true;
+}
+
+// 由 kernfs 节点取得 cgroup 内路径 /uid_<uid>[/pid_<pid>]/cgroup.freeze, 不依赖 struct file 布局
+static bool binder_cgroup_ids(struct kernfs_open_file* of, int* uid, int* pid) {
+  char path[THAW_PATH_SIZE];
+  if (!of || !of->kn || kernfs_path_from_node(of->kn, NULL, path, sizeof(path)) <= 0)
+    return false;
+  const char* p = path;
+  *pid = 0;
+  if (!binder_cgroup_id(&p, "/uid_", uid))
+    return false;
+  binder_cgroup_id(&p, "/pid_", pid);
+  return !strcmp(p, "/cgroup.freeze");
+}
+
+// 写入 1 后进程设置 JOBCTL_TRAP_FREEZE 即视为冻结, 到 cgroup_enter_frozen 之间可能还要很久, 请求冻结时先置位
+// 其他进程改写 cgroup.freeze 说明守护进程已自行解冻或冻结, 本模块的写入只来自 rekernel_thaw 线程
+static void cgroup_freeze_write_before(hook_fargs4_t* args, void* udata) {
+  const char* buf = (const char*)args->arg1;
+  int uid, pid;
+  args->local.data0 = 0;
+  if (!binder_cgroup_ids((struct kernfs_open_file*)args->arg0, &uid, &pid))
+    return;
+  if (buf[0] == '1')
+    rekernel_uid_frozen(uid);
+  else if (buf[0] == '0')
+    args->local.data0 = uid;
+  if (smp_load_acquire(&binder_thaw_nr) && current != binder_thaw_task)
+    binder_thaw_cancel(uid, pid);
+}
+
+// 写入 0 后尚未进入 frozen 的进程不会经过 cgroup_leave_frozen, 写入生效后重新确认
+static void cgroup_freeze_write_after(hook_fargs4_t* args, void* udata) {
+  if (args->local.data0)
+    rekernel_uid_thaw((uid_t)args->local.data0);
+}
+
+// cgroupv1_freeze, 请求冻结时先置位, 与 cgroup_freeze_write 相同
+static void freeze_task_before(hook_fargs1_t* args, void* udata) {
+  struct task_struct* p = (struct task_struct*)args->arg0;
+  rekernel_uid_frozen(task_uid(p).val);
+}
+
+// Android 的 cgroupv2 进程分组: /sys/fs/cgroup/uid_<uid>/pid_<pid>, pid 为 0 时指 uid 分组
+static void binder_cgroup_path(char* path, uid_t uid, pid_t pid, const char* name) {
+  if (pid)
+    snprintf(path, THAW_PATH_SIZE, "/sys/fs/cgroup/uid_%d/pid_%d/%s", uid, pid, name);
+  else
+    snprintf(path, THAW_PATH_SIZE, "/sys/fs/cgroup/uid_%d/%s", uid, name);
+}
+
+static ssize_t binder_cgroup_read(uid_t uid, pid_t pid, const char* name, char* buf, size_t size) {
+  char path[THAW_PATH_SIZE];
+  binder_cgroup_path(path, uid, pid, name);
+  struct file* file = filp_open(path, O_RDONLY, 0);
+  if (IS_ERR(file))
+    return PTR_ERR(file);
+  loff_t pos = 0;
+  ssize_t ret = kernel_read(file, buf, size - 1, &pos);
+  filp_close(file, NULL);
+  buf[ret > 0 ? ret : 0] = '\0';
+  return ret;
+}
+
+static bool binder_cgroup_write(uid_t uid, pid_t pid, const char* name, const char* value) {
+  char path[THAW_PATH_SIZE];
+  binder_cgroup_path(path, uid, pid, name);
+  struct file* file = filp_open(path, O_WRONLY, 0);
+  if (IS_ERR(file))
+    return false;
+  loff_t pos = 0;
+  ssize_t ret = kernel_write(file, value, 1, &pos);
+  filp_close(file, NULL);
+  return ret == 1;
+}
+
+// cgroup.freeze 只反映本级的设置, 祖先冻结时本级仍为 0
+static int binder_cgroup_freeze(uid_t uid, pid_t pid) {
+  char buf[4];
+  if (binder_cgroup_read(uid, pid, "cgroup.freeze", buf, sizeof(buf)) <= 0)
+    return -1;
+  return buf[0] == '1';
+}
+
+// cgroup.events 中的 frozen 为本级实际的冻结状态, 包括祖先导致的冻结
+static bool binder_cgroup_frozen(uid_t uid, pid_t pid) {
+  char buf[64];
+  if (binder_cgroup_read(uid, pid, "cgroup.events", buf, sizeof(buf)) <= 0)
+    return false;
+  for (char* line = buf; line; line = strchr(line, '\n')) {
+    if (*line == '\n')
+      line++;
+    if (!strncmp(line, "frozen ", 7))
+      return line[7] == '1';
+  }
+  return false;
+}
+
+// 只处理守护进程在 pid 分组上的自行冻结, uid 分组冻结或状态不明时不动, 由守护进程按普通 transaction 处理
+static bool binder_thaw_begin(struct binder_thaw_lease* lease) {
+  if (binder_cgroup_freeze(lease->uid, 0) != 0 || binder_cgroup_freeze(lease->uid, lease->pid) != 1)
+    return false;
+  if (!binder_cgroup_frozen(lease->uid, lease->pid))
+    return false;
+  return binder_cgroup_write(lease->uid, lease->pid, "cgroup.freeze", "0");
+}
+
+// 只撤销本模块写下的 0, 期间已被其他进程重新冻结时不再写
+static void binder_thaw_end(struct binder_thaw_lease* lease) {
+  if (binder_cgroup_freeze(lease->uid, lease->pid) == 0)
+    binder_cgroup_write(lease->uid, lease->pid, "cgroup.freeze", "1");
+}
+
+static inline void binder_thaw_free(struct binder_thaw_lease* lease) {
+  smp_store_release(&lease->state, THAW_FREE);
+  add_return_u32(&binder_thaw_nr, -1);
+}
+
+// 处理各租约, 返回距离最近一个租约到期的 jiffies, all 为 true 时全部重新冻结
+static long binder_thaw_scan(bool all) {
+  long timeout = MAX_SCHEDULE_TIMEOUT;
+  if (!smp_load_acquire(&binder_thaw_nr))
+    return timeout;
+
+  uint32_t now = rekernel_jiffies();
+  for (int i = 0; i < THAW_LEASE_MAX; i++) {
+    struct binder_thaw_lease* lease = &binder_thaw_leases[i];
+    uint32_t state = smp_load_acquire(&lease->state);
+    switch (state) {
+    case THAW_REQUEST:
+      if (cmpxchg_u32(&lease->state, THAW_REQUEST, THAW_THAWING) != THAW_REQUEST)
+        break;
+      if (all || !binder_thaw_begin(lease)) {
+        rekernel_submit_event(&lease->event);
+        binder_thaw_free(lease);
+        break;
+      }
+      rekernel_stat_inc(REKERNEL_STAT_AUTO_THAW);
+      lease->event.subtype = AUTO_THAW;
+      rekernel_submit_event(&lease->event);
+      lease->expires = now + rekernel_thaw_lease_jiffies;
+      // 解冻期间已全部回复或被取消, 立即再处理一次
+      if (cmpxchg_u32(&lease->state, THAW_THAWING, THAW_ACTIVE) != THAW_THAWING)
+        timeout = 0;
+      else if (rekernel_thaw_lease_jiffies < timeout)
+        timeout = rekernel_thaw_lease_jiffies;
+      break;
+    case THAW_ACTIVE:
+      if (!all && (int32_t)(now - lease->expires) < 0) {
+        if ((long)(lease->expires - now) < timeout)
+          timeout = lease->expires - now;
+        break;
+      }
+      if (cmpxchg_u32(&lease->state, THAW_ACTIVE, THAW_BUSY) != THAW_ACTIVE)
+        break;
+      // 到期时仍有未回复的消息也重新冻结, 并照常报告, 由守护进程决定是否解冻
+      binder_thaw_end(lease);
+      if (binder_thaw_pending(lease)) {
+        lease->event.subtype = TRANSACTION;
+        rekernel_submit_event(&lease->event);
+      }
+      binder_thaw_free(lease);
+      break;
+    case THAW_RELEASE:
+      if (cmpxchg_u32(&lease->state, THAW_RELEASE, THAW_BUSY) != THAW_RELEASE)
+        break;
+      binder_thaw_end(lease);
+      binder_thaw_free(lease);
+      break;
+    case THAW_CANCEL:
+      if (cmpxchg_u32(&lease->state, THAW_CANCEL, THAW_BUSY) == THAW_CANCEL)
+        binder_thaw_free(lease);
+      break;
+    default:
+      break;
+    }
+  }
+  return timeout;
+}
+
+static int binder_thaw_worker(void* data) {
+  while (!kthread_should_stop()) {
+    xchg_u32(&binder_thaw_wake_pending, 0);
+    long timeout = binder_thaw_scan(false);
+    if (timeout == MAX_SCHEDULE_TIMEOUT)
+      rekernel_thread_idle(&binder_thaw_wait, &binder_thaw_wake_pending);
+    else if (timeout)
+      schedule_timeout_interruptible(timeout);
+  }
+  // 卸载时不留下被临时解冻的应用, 报告的事件由随后停止的 rekernel 线程发送
+  binder_thaw_scan(true);
+  return 0;
+}
+
+static void rekernel_report(int reporttype, int type, pid_t src_pid, struct task_struct* src, pid_t dst_pid, struct task_struct* dst, bool oneway, struct binder_transaction* t) {
+  // netlink 创建失败时仍可通过 /proc/rekernel/ 下的文件接收
+  if (rekernel_netlink_enabled == IZERO)
+    start_rekernel_server();
+  int group = rekernel_group(reporttype, type);
+  if (!rekernel_has_consumer(group))
+    return;
+
+  struct rekernel_event event;
+  uint32_t suppressed;
+#ifdef CONFIG_NETWORK
+  if (reporttype == NETWORK) {
+    // 网络事件的 dst_pid 实际为 uid
+    if (!rekernel_interested(dst_pid, group)) {
+      rekernel_stat_inc(REKERNEL_STAT_FILTERED);
+      return;
+    }
+    if (!rekernel_throttle(dst_pid, group, &suppressed))
+      return;
+    rekernel_event_init(&event, NETWORK, 0, oneway, 0, 0, 0, dst_pid);
+    event.suppressed = suppressed;
+#ifdef CONFIG_DEBUG
+    logkm("type=Network,target=%d;\n", dst_pid);
+#endif /* CONFIG_DEBUG */
+    rekernel_submit_event(&event);
+    return;
+  }
+#endif /* CONFIG_NETWORK */
+
+  if (reporttype != BINDER && reporttype != SIGNAL)
+    return;
+
+  uid_t dst_uid = task_uid(dst).val;
+  if (!rekernel_interested(dst_uid, group)) {
+    rekernel_stat_inc(REKERNEL_STAT_FILTERED);
+    return;
+  }
+  if (!rekernel_uid_maybe_frozen(dst_uid) || !frozen_task_group(dst)) {
+    // 没有解冻 hook 的内核 (如 4.x 的 cgroupv2_freeze 模拟) 在此发现解冻
+    rekernel_uid_thawed(dst_uid);
+    return;
+  }
+
+  uid_t src_uid = task_uid(src).val;
+  if (src_uid == dst_uid)
+    return;
+  uint32_t code = 0, iface = 0;
+  if (t && type != REPLY) {
+    code = binder_transaction_code(t);
+    if (binder_iface_wanted())
+      iface = binder_interface_hash(t);
+    if (!binder_filter_allowed(dst_uid, code, iface)) {
+      rekernel_stat_inc(REKERNEL_STAT_FILTERED);
+      return;
+    }
+  }
+  rekernel_event_init(&event, reporttype, type, oneway, src_pid, src_uid, dst_pid, dst_uid);
+  event.code = code;
+  event.iface = iface;
+  // 仅支持 cgroupv2 冻结, 由 rekernel 线程检查冻结状态后报告 auto_thaw 或原样的 transaction
+  if (type == TRANSACTION && !oneway && rekernel_auto_thaw != UZERO && jobctl_frozen(dst) && binder_thaw_request(&event))
+    return;
+  if (!rekernel_throttle(dst_uid, group, &suppressed))
+    return;
+  event.suppressed = suppressed;
+#ifdef CONFIG_DEBUG
+  char binder_kmsg[PACKET_SIZE];
+  rekernel_format_event(&event, binder_kmsg, sizeof(binder_kmsg));
+  logkm("%s\n", binder_kmsg);
+  logkm("src_comm=%s,dst_comm=%s\n", get_task_comm(src), get_task_comm(dst));
+#endif /* CONFIG_DEBUG */
+#ifdef CONFIG_DEBUG_CMDLINE
+  char src_cmdline[PATH_MAX], dst_cmdline[PATH_MAX];
+  memset(&src_cmdline, 0, PATH_MAX);
+  memset(&dst_cmdline, 0, PATH_MAX);
+  int res = 0;
+  res = get_cmdline(src, src_cmdline, PATH_MAX - 1);
+  src_cmdline[res] = '\0';
+  res = get_cmdline(dst, dst_cmdline, PATH_MAX - 1);
+  dst_cmdline[res] = '\0';
+  logkm("src_cmdline=%s,dst_cmdline=%s\n", src_cmdline, dst_cmdline);
+#endif /* CONFIG_DEBUG_CMDLINE */
+  rekernel_submit_event(&event);
+}
+
+static void binder_reply_handler(pid_t src_pid, struct task_struct* src, pid_t dst_pid, struct task_struct* dst, bool oneway, struct binder_transaction* t) {
+  if (unlikely(!dst))
+    return;
+  if (task_uid(dst).val > MAX_SYSTEM_UID || src_pid == dst_pid)
+    return;
+
+  // oneway=0
+  rekernel_report(BINDER, REPLY, src_pid, src, dst_pid, dst, oneway, t);
+}
+
+static void binder_trans_handler(pid_t src_pid, struct task_struct* src, pid_t dst_pid, struct task_struct* dst, bool oneway, struct binder_transaction* t) {
+  if (unlikely(!dst))
+    return;
+  if ((task_uid(dst).val <= MIN_USERAPP_UID) || src_pid == dst_pid)
+    return;
+
+  rekernel_report(BINDER, TRANSACTION, src_pid, src, dst_pid, dst, oneway, t);
+}
+
+static void binder_overflow_handler(pid_t src_pid, struct task_struct* src, pid_t dst_pid, struct task_struct* dst, bool oneway, struct binder_transaction* t) {
+  if (unlikely(!dst))
+    return;
+
+  // oneway=1
+  rekernel_report(BINDER, OVERFLOW, src_pid, src, dst_pid, dst, oneway, t);
+}
+
+// 每个进程低于高水位时只报告一次, 回到低水位以上或应用解冻后重新开始
+static bool binder_async_pressure(struct binder_proc* proc, size_t free_async_space, size_t buffer_size) {
+  size_t high = buffer_size * rekernel_async_high / 100 + ASYNC_WATERMARK_BASE;
+  if (rekernel_async_low == UZERO || !proc->tsk)
+    return free_async_space < high;
+
+  size_t low = buffer_size * rekernel_async_low / 100 + ASYNC_WATERMARK_BASE;
+  uid_t uid = task_uid(proc->tsk).val;
+  struct binder_pressure_slot* slot;
+  if (free_async_space < high) {
+    // pid 复用时 uid 不同, 视为新的进程
+    slot = binder_pressure_slot(proc->pid, true);
+    if (!slot)
+      return true;
+    if (xchg_u32(&slot->uid, uid) == uid)
+      return false;
+    // 解冻时靠 uid 槽位找到需要清理的进程, 没有槽位时不记录
+    struct rekernel_uid_slot* uid_slot = rekernel_uid_slot(uid, true);
+    if (!uid_slot)
+      binder_pressure_release(slot);
+    else if (!smp_load_acquire(&uid_slot->async_pressure))
+      smp_store_release(&uid_slot->async_pressure, 1);
+    return true;
+  }
+  if (free_async_space > (low > high ? low : high)) {
+    slot = binder_pressure_slot(proc->pid, false);
+    if (slot && smp_load_acquire(&slot->uid) == uid)
+      binder_pressure_release(slot);
+  }
+  return false;
+}
+
+static void __rekernel_binder_transaction(void* data, bool reply, struct binder_transaction* t, struct binder_node* target_node) {
+  struct binder_proc* to_proc = binder_transaction_to_proc(t);
+  if (!to_proc)
+    return;
+  struct binder_thread* from = binder_transaction_from(t);
+
+  if (reply) {
+    if (smp_load_acquire(&binder_thaw_nr))
+      binder_thaw_track(task_tgid(current), to_proc->pid, true);
+    binder_reply_handler(task_pid(current), current, to_proc->pid, to_proc->tsk, false, t);
+  } else if (from) {
+    // 需要接口描述符时改在 binder_proc_transaction 中报告, 此时 buffer 已经填充
+    if (trace != UZERO && binder_iface_wanted() && !binder_transaction_buffer(t))
+      return;
+    if (from->proc) {
+      binder_trans_handler(from->proc->pid, from->proc->tsk, to_proc->pid, to_proc->tsk, false, t);
+    }
+    if (from->proc && smp_load_acquire(&binder_thaw_nr))
+      binder_thaw_track(to_proc->pid, from->proc->pid, false);
+  } else { // oneway=1
+    // binder_trans_handler(task_pid(current), current, to_proc->pid, to_proc->tsk, true);
+    // 与同步消息相同, 需要接口描述符时 overflow 改在 binder_proc_transaction 中判断, 此时已分配的 buffer 计入水位
+    if (trace != UZERO && binder_iface_wanted() && !binder_transaction_buffer(t))
+      return;
+
+    struct binder_alloc* target_alloc = binder_proc_alloc(to_proc);
+    size_t free_async_space = binder_alloc_free_async_space(target_alloc);
+    size_t buffer_size = binder_alloc_buffer_size(target_alloc);
+    if (binder_async_pressure(to_proc, free_async_space, buffer_size)) {
+      binder_overflow_handler(task_pid(current), current, to_proc->pid, to_proc->tsk, true, t);
+    }
+  }
+}
+
+static void rekernel_binder_transaction(void* data, bool reply, struct binder_transaction* t, struct binder_node* target_node) {
+  uint64_t start = rekernel_latency_begin();
+  __rekernel_binder_transaction(data, reply, t, target_node);
+  rekernel_latency_end(LATENCY_BINDER_TRANSACTION, start);
+}
+
+static bool binder_can_update_transaction(struct binder_transaction* t1, struct binder_transaction* t2) {
+  struct binder_proc* t1_to_proc = binder_transaction_to_proc(t1);
+  struct binder_buffer* t1_buffer = binder_transaction_buffer(t1);
+  unsigned int t1_code = binder_transaction_code(t1);
+  unsigned int t1_flags = binder_transaction_flags(t1);
+  binder_uintptr_t t1_ptr = binder_node_ptr(t1_buffer->target_node);
+  binder_uintptr_t t1_cookie = binder_node_cookie(t1_buffer->target_node);
+
+  struct binder_proc* t2_to_proc = binder_transaction_to_proc(t2);
+  struct binder_buffer* t2_buffer = binder_transaction_buffer(t2);
+  unsigned int t2_code = binder_transaction_code(t2);
+  unsigned int t2_flags = binder_transaction_flags(t2);
+  binder_uintptr_t t2_ptr = binder_node_ptr(t2_buffer->target_node);
+  binder_uintptr_t t2_cookie = binder_node_cookie(t2_buffer->target_node);
+
+  if ((t1_flags & t2_flags & TF_ONE_WAY) != TF_ONE_WAY || !t1_to_proc || !t2_to_proc)
+    return false;
+  if (t1_to_proc->tsk == t2_to_proc->tsk
+    && t1_code == t2_code
+    && t1_flags == t2_flags
+    && (binder_proc_is_frozen_offset == UZERO ? true : t1_buffer->pid == t2_buffer->pid) // 4.19 以下无此数据
+    && t1_ptr == t2_ptr
+    && t1_cookie == t2_cookie)
+    return true;
+  return false;
+}
+
+// async_todo 只从头部出队, 因此序号不小于队首的索引项仍在队列中.
+// 索引项只在确认位于队尾时插入, 队首不在索引中时按队列顺序重建.
+// 冻结期间队列不会被消费, 进程离开冻结时其所在分片的索引项失效, 避免已释放的消息地址被复用后误认为队首,
+// 因此只在能观察到所有解冻 (rekernel_frozen_bitmap) 时使用索引.
+// 分片由目标进程 pid 决定, 以分片锁保护, 不同进程互不阻塞
+struct binder_txn_entry {
+  struct binder_transaction* t; // NULL 为空
+  struct binder_node* node;
+  uint64_t seq;
+  unsigned int code;
+  unsigned int flags;
+  pid_t pid;
+  uint64_t payload; // 入队前计算的内容指纹, 0 为不比较, 不重新计算
+  int32_t ptr_next;
+  int32_t key_prev;
+  int32_t key_next;
+  uint32_t key_hash;
+};
+
+struct binder_txn_index {
+  spinlock_t lock;
+  uint64_t seq;
+  uint64_t min_seq; // 小于此序号的索引项全部失效
+  uint32_t next;
+  int32_t ptr_heads[TXN_INDEX_SIZE];
+  int32_t key_heads[TXN_INDEX_SIZE];
+  int32_t key_tails[TXN_INDEX_SIZE];
+  struct binder_txn_entry entries[TXN_INDEX_SIZE];
+};
+static struct binder_txn_index* binder_txn_index; // TXN_INDEX_SHARDS 个分片
+// UZERO: 不比较消息内容
+static unsigned long binder_payload = UZERO;
+
+static inline pid_t binder_transaction_sender_pid(struct binder_transaction* t) {
+  // 4.19 以下无此数据
+  return binder_proc_is_frozen_offset == UZERO ? 0 : binder_transaction_buffer(t)->pid;
+}
+
+static inline struct binder_txn_index* binder_txn_shard(pid_t tgid) {
+  return &binder_txn_index[((uint32_t)tgid * 0x9E3779B9U) >> (32 - TXN_INDEX_SHARD_BITS)];
+}
+
+static inline uint32_t binder_txn_ptr_hash(const void* ptr) {
+  return ((uint64_t)ptr * 0x9E3779B97F4A7C15ULL) >> (64 - TXN_INDEX_BITS);
+}
+
+// 指纹不参与散列, TF_UPDATE_TXN 不比较内容, 需要按键找到所有内容的项
+static inline uint32_t binder_txn_key_hash(struct binder_node* node, unsigned int code, unsigned int flags, pid_t pid) {
+  uint64_t key = (uint64_t)node ^ ((uint64_t)code << 32) ^ ((uint64_t)flags << 16) ^ (uint32_t)pid;
+  return (key * 0x9E3779B97F4A7C15ULL) >> (64 - TXN_INDEX_BITS);
+}
+
+static inline bool binder_txn_entry_match(struct binder_txn_entry* e, struct binder_node* node, unsigned int code, unsigned int flags, pid_t pid, uint64_t payload) {
+  return e->node == node && e->code == code && e->flags == flags && e->pid == pid && e->payload == payload;
+}
+
+static inline uint64_t binder_payload_round(uint64_t acc, uint64_t input) {
+  acc += input * 0xC2B2AE3D27D4EB4FULL;
+  acc = (acc << 31) | (acc >> 33);
+  return acc * 0x9E3779B185EBCA87ULL;
+}
+
+// 每次复制 BINDER_PAYLOAD_CHUNK 字节, 四路独立累加, 复制失败时返回非 0
+static int binder_payload_update(struct binder_alloc* alloc, struct binder_buffer* buffer, size_t start, size_t len, uint64_t* acc) {
+  uint64_t chunk[BINDER_PAYLOAD_CHUNK / sizeof(uint64_t)];
+  for (size_t offset = 0; offset < len; offset += BINDER_PAYLOAD_CHUNK) {
+    size_t bytes = len - offset < BINDER_PAYLOAD_CHUNK ? len - offset : BINDER_PAYLOAD_CHUNK;
+    memset(chunk, 0, sizeof(chunk));
+    if (binder_alloc_copy_from_buffer(alloc, chunk, buffer, start + offset, bytes))
+      return -EFAULT;
+    for (int i = 0; i < BINDER_PAYLOAD_CHUNK / sizeof(uint64_t); i += 4) {
+      acc[0] = binder_payload_round(acc[0], chunk[i]);
+      acc[1] = binder_payload_round(acc[1], chunk[i + 1]);
+      acc[2] = binder_payload_round(acc[2], chunk[i + 2]);
+      acc[3] = binder_payload_round(acc[3], chunk[i + 3]);
+    }
+  }
+  return 0;
+}
+
+// 没有入队时记录的指纹, 由地址生成, 不与其他消息相同, 因而不会被合并
+static inline uint64_t binder_payload_unknown(struct binder_transaction* t) {
+  return (uint64_t)t | 1;
+}
+
+// 计算数据与对象偏移表的完整指纹, 0 为不比较. 复制整个消息, 只在入队前不持锁时调用
+// 总长超过 binder_payload 或复制失败时返回 binder_payload_unknown
+static uint64_t binder_transaction_payload(struct binder_transaction* t) {
+  if (binder_payload == UZERO || !binder_alloc_copy_from_buffer)
+    return 0;
+  struct binder_buffer* buffer = binder_transaction_buffer(t);
+  struct binder_proc* proc = binder_transaction_to_proc(t);
+  if (!buffer || !proc)
+    return 0;
+
+  uint64_t unique = binder_payload_unknown(t);
+  size_t data_size = buffer->data_size, offsets_size = buffer->offsets_size;
+  if (data_size + offsets_size > binder_payload)
+    return unique;
+
+  // 偏移表紧跟在按指针大小对齐的数据之后
+  uint64_t acc[4] = { 0x60EA27EEADC0B5D6ULL, 0xC2B2AE3D27D4EB4FULL, 0, 0x61C8864E7A143579ULL };
+  struct binder_alloc* alloc = binder_proc_alloc(proc);
+  if (binder_payload_update(alloc, buffer, 0, data_size, acc) ||
+    binder_payload_update(alloc, buffer, (data_size + sizeof(void*) - 1) & ~(sizeof(void*) - 1), offsets_size, acc))
+    return unique;
+
+  uint64_t hash = ((acc[0] << 1) | (acc[0] >> 63)) + ((acc[1] << 7) | (acc[1] >> 57)) + ((acc[2] << 12) | (acc[2] >> 52)) + ((acc[3] << 18) | (acc[3] >> 46));
+  hash ^= data_size + ((uint64_t)offsets_size << 32);
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 33;
+  return hash ? hash : 1;
+}
+
+static int32_t binder_txn_find(struct binder_txn_index* index, struct binder_transaction* t) {
+  int32_t i = index->ptr_heads[binder_txn_ptr_hash(t)];
+  while (i >= 0 && index->entries[i].t != t)
+    i = index->entries[i].ptr_next;
+  return i;
+}
+
+static void binder_txn_unlink(struct binder_txn_index* index, int32_t i) {
+  struct binder_txn_entry* e = &index->entries[i];
+
+  int32_t* link = &index->ptr_heads[binder_txn_ptr_hash(e->t)];
+  while (*link != i)
+    link = &index->entries[*link].ptr_next;
+  *link = e->ptr_next;
+
+  if (e->key_prev >= 0)
+    index->entries[e->key_prev].key_next = e->key_next;
+  else
+    index->key_heads[e->key_hash] = e->key_next;
+  if (e->key_next >= 0)
+    index->entries[e->key_next].key_prev = e->key_prev;
+  else
+    index->key_tails[e->key_hash] = e->key_prev;
+  e->t = NULL;
+}
+
+static void binder_txn_insert(struct binder_txn_index* index, struct binder_transaction* t, struct binder_node* node, unsigned int code, unsigned int flags, pid_t pid, uint64_t payload) {
+  int32_t i = binder_txn_find(index, t);
+  if (i >= 0)
+    binder_txn_unlink(index, i);
+
+  i = index->next++ % TXN_INDEX_SIZE;
+  struct binder_txn_entry* e = &index->entries[i];
+  if (e->t)
+    binder_txn_unlink(index, i);
+
+  uint32_t ptr_hash = binder_txn_ptr_hash(t);
+  e->t = t;
+  e->node = node;
+  e->seq = ++index->seq;
+  e->code = code;
+  e->flags = flags;
+  e->pid = pid;
+  e->payload = payload;
+  e->ptr_next = index->ptr_heads[ptr_hash];
+  index->ptr_heads[ptr_hash] = i;
+
+  e->key_hash = binder_txn_key_hash(node, code, flags, pid);
+  e->key_prev = index->key_tails[e->key_hash];
+  e->key_next = -1;
+  if (e->key_prev >= 0)
+    index->entries[e->key_prev].key_next = i;
+  else
+    index->key_heads[e->key_hash] = i;
+  index->key_tails[e->key_hash] = i;
+}
+
+// 内核按 TF_UPDATE_TXN 移除队列中间的消息时, 丢弃同键的所有索引项, 内核不比较内容, 不论指纹
+static void binder_txn_drop(struct binder_txn_index* index, struct binder_node* node, unsigned int code, unsigned int flags, pid_t pid) {
+  int32_t i = index->key_heads[binder_txn_key_hash(node, code, flags, pid)];
+  while (i >= 0) {
+    struct binder_txn_entry* e = &index->entries[i];
+    int32_t next = e->key_next;
+    if (binder_txn_entry_match(e, node, code, flags, pid, e->payload))
+      binder_txn_unlink(index, i);
+    i = next;
+  }
+}
+
+// 进程的每个线程离开冻结时都会调用, 上次失效后没有插入新项时不加锁直接返回
+static void binder_txn_invalidate(pid_t tgid) {
+  if (!binder_txn_index)
+    return;
+  struct binder_txn_index* index = binder_txn_shard(tgid);
+  if (*(volatile uint64_t*)&index->min_seq > *(volatile uint64_t*)&index->seq)
+    return;
+  spin_lock(&index->lock);
+  index->min_seq = index->seq + 1;
+  spin_unlock(&index->lock);
+}
+
+static void binder_txn_invalidate_all(void) {
+  for (int i = 0; i < TXN_INDEX_SHARDS; i++) {
+    struct binder_txn_index* index = &binder_txn_index[i];
+    spin_lock(&index->lock);
+    index->min_seq = index->seq + 1;
+    spin_unlock(&index->lock);
+  }
+}
+
+// 有效索引项中记录的指纹, 比较内容且没有记录时返回 binder_payload_unknown
+static uint64_t binder_txn_payload_of(struct binder_txn_index* index, uint64_t min_seq, struct binder_node* node, struct binder_transaction* t) {
+  if (binder_payload == UZERO)
+    return 0;
+  int32_t i = binder_txn_find(index, t);
+  struct binder_txn_entry* e = i >= 0 ? &index->entries[i] : NULL;
+  if (e && e->seq >= min_seq && e->payload && binder_txn_entry_match(e, node, binder_transaction_code(t), binder_transaction_flags(t), binder_transaction_sender_pid(t), e->payload))
+    return e->payload;
+  return binder_payload_unknown(t);
+}
+
+// 重建前使分片的全部索引项失效, 之后只有本次插入的项有效. 持锁时不重新计算指纹, 沿用原有效项的记录
+static void binder_txn_rebuild(struct binder_txn_index* index, struct binder_node* node, struct list_head* target_list) {
+  struct binder_work* w;
+  uint64_t min_seq = index->min_seq;
+  index->min_seq = index->seq + 1;
+  list_for_each_entry(w, target_list, entry) {
+    if (w->type != BINDER_WORK_TRANSACTION)
+      continue;
+    struct binder_transaction* t = container_of(w, struct binder_transaction, work);
+    uint64_t payload = binder_txn_payload_of(index, min_seq, node, t);
+    binder_txn_insert(index, t, node, binder_transaction_code(t), binder_transaction_flags(t), binder_transaction_sender_pid(t), payload);
+  }
+}
+
+// 队首的序号, 队列为空时返回 false
+static bool binder_txn_head_seq(struct binder_txn_index* index, struct binder_node* node, struct list_head* target_list, uint64_t* seq) {
+  if (list_empty(target_list))
+    return false;
+
+  struct binder_transaction* head = container_of(target_list->next, struct binder_transaction, work.entry);
+  for (int retry = 0; retry < 2; retry++) {
+    int32_t i = binder_txn_find(index, head);
+    struct binder_txn_entry* e = i >= 0 ? &index->entries[i] : NULL;
+    // 队首内容不会改变, 不重新计算指纹
+    if (e && e->seq >= index->min_seq && binder_txn_entry_match(e, node, binder_transaction_code(head), binder_transaction_flags(head), binder_transaction_sender_pid(head), e->payload)) {
+      *seq = e->seq;
+      return true;
+    }
+    if (!retry)
+      binder_txn_rebuild(index, node, target_list);
+  }
+  return false;
+}
+
+// 按队列顺序收集可以更新的消息, 最多记录 max 个, 返回总数
+// 队列中的消息没有记录的指纹, 比较内容时不合并
+static uint32_t binder_collect_outdated_linear(struct binder_transaction* t, uint64_t payload, struct list_head* target_list, struct binder_transaction** matches, uint32_t max) {
+  struct binder_work* w;
+  uint32_t count = 0;
+  if (payload)
+    return 0;
+
+  list_for_each_entry(w, target_list, entry) {
+    if (w->type != BINDER_WORK_TRANSACTION)
+      continue;
+    struct binder_transaction* t_queued = container_of(w, struct binder_transaction, work);
+    if (binder_can_update_transaction(t_queued, t)) {
+      if (count < max)
+        matches[count] = t_queued;
+      count++;
+    }
+  }
+  return count;
+}
+
+static uint32_t binder_collect_outdated(struct binder_transaction* t, uint64_t payload, struct binder_proc* proc, struct binder_node* node, struct list_head* target_list, struct binder_transaction** matches, uint32_t max) {
+  if (!binder_txn_index)
+    return binder_collect_outdated_linear(t, payload, target_list, matches, max);
+
+  unsigned int code = binder_transaction_code(t);
+  unsigned int flags = binder_transaction_flags(t);
+  pid_t pid = binder_transaction_sender_pid(t);
+  uint32_t count = 0;
+  uint64_t head_seq;
+
+  struct binder_txn_index* index = binder_txn_shard(proc->pid);
+  spin_lock(&index->lock);
+  if (!binder_txn_head_seq(index, node, target_list, &head_seq)) {
+    spin_unlock(&index->lock);
+    // 队列为空或超过索引容量
+    return list_empty(target_list) ? 0 : binder_collect_outdated_linear(t, payload, target_list, matches, max);
+  }
+
+  int32_t i = index->key_heads[binder_txn_key_hash(node, code, flags, pid)];
+  while (i >= 0) {
+    struct binder_txn_entry* e = &index->entries[i];
+    int32_t next = e->key_next;
+    if (binder_txn_entry_match(e, node, code, flags, pid, payload)) {
+      if (e->seq < head_seq) {
+        // 已出队, 不会再次有效
+        binder_txn_unlink(index, i);
+      } else {
+        if (count < max)
+          matches[count] = e->t;
+        count++;
+      }
+    }
+    i = next;
+  }
+  spin_unlock(&index->lock);
+  return count;
+}
+
+// 摘除的消息同时移出索引
+static void binder_txn_forget(struct binder_proc* proc, struct binder_transaction* t) {
+  if (!binder_txn_index)
+    return;
+  struct binder_txn_index* index = binder_txn_shard(proc->pid);
+  spin_lock(&index->lock);
+  int32_t i = binder_txn_find(index, t);
+  if (i >= 0)
+    binder_txn_unlink(index, i);
+  spin_unlock(&index->lock);
+}
+
+static inline void outstanding_txns_dec(struct binder_proc* proc) {
+  if (binder_proc_outstanding_txns_offset != UZERO) {
+    int* outstanding_txns = binder_proc_outstanding_txns(proc);
+    (*outstanding_txns)--;
+  }
+}
+
+static inline void binder_release_entire_buffer(struct binder_proc* proc, struct binder_thread* thread, struct binder_buffer* buffer, bool is_failure) {
+  if (binder_transaction_buffer_release_ver6 == IZERO) {
+    binder_transaction_buffer_release_v6(proc, thread, buffer, 0, is_failure);
+  } else if (binder_transaction_buffer_release_ver5 == IZERO) {
+    binder_size_t off_end_offset = ALIGN(buffer->data_size, sizeof(void*));
+    off_end_offset += buffer->offsets_size;
+
+    binder_transaction_buffer_release(proc, thread, buffer, off_end_offset, is_failure);
+  } else if (binder_transaction_buffer_release_ver4 == IZERO) {
+    binder_transaction_buffer_release_v4(proc, buffer, 0, is_failure);
+  } else {
+    binder_transaction_buffer_release_v3(proc, buffer, NULL);
+  }
+}
+
+static inline void binder_stats_deleted(enum binder_stat_types type) {
+  atomic_inc(&kvar(binder_stats)->obj_deleted[type]);
+}
+
+// 过时消息摘除后放入每 CPU 回收链表, 由 worker 批量释放, 复用 t->work 保存链表指针
+struct binder_reclaim {
+  struct binder_reclaim* next;
+  struct binder_buffer* buffer;
+  pid_t pid; // 目标进程
+};
+static uint64_t* binder_reclaim_heads;
+
+static void binder_free_outdated(struct binder_proc* proc, struct binder_transaction* t_outdated, struct binder_buffer* buffer) {
+  rekernel_stat_inc(REKERNEL_STAT_TXN_FREED);
+  rekernel_stat_add(REKERNEL_STAT_TXN_BYTES, buffer->data_size + buffer->offsets_size + buffer->extra_buffers_size);
+  binder_release_entire_buffer(proc, NULL, buffer, false);
+  binder_alloc_free_buf(binder_proc_alloc(proc), buffer);
+  kfree(t_outdated);
+  binder_stats_deleted(BINDER_STAT_TRANSACTION);
+}
+
+static void binder_reclaim_push(struct binder_proc* proc, struct binder_transaction* t_outdated, struct binder_buffer* buffer) {
+  struct binder_reclaim* reclaim = (struct binder_reclaim*)&t_outdated->work;
+  reclaim->buffer = buffer;
+  reclaim->pid = proc->pid;
+
+  volatile uint64_t* head = &binder_reclaim_heads[rekernel_cpu_slot()];
+  uint64_t old;
+  do {
+    old = smp_load_acquire(head);
+    reclaim->next = (struct binder_reclaim*)old;
+  } while (cmpxchg_u64(head, old, (uint64_t)reclaim) != old);
+  if (!old)
+    rekernel_worker_wake();
+}
+
+static bool binder_proc_alive(struct binder_proc* proc, pid_t pid) {
+  struct hlist_node* node;
+  for (node = kvar(binder_procs)->first; node; node = node->next) {
+    if (node == &proc->proc_node)
+      return proc->pid == pid;
+  }
+  return false;
+}
+
+// 持有 binder_procs_lock 时 binder_deferred_release 无法摘除进程, 此时目标进程的 binder_alloc 仍然有效
+static void binder_reclaim_flush(void) {
+  for (uint32_t cpu = 0; cpu < rekernel_nr_cpus; cpu++) {
+    if (!smp_load_acquire(&binder_reclaim_heads[cpu]))
+      continue;
+    struct binder_reclaim* reclaim = (struct binder_reclaim*)xchg_u64(&binder_reclaim_heads[cpu], 0);
+
+    mutex_lock(kvar(binder_procs_lock));
+    struct binder_proc* alive = NULL;
+    while (reclaim) {
+      struct binder_reclaim* next = reclaim->next;
+      struct binder_transaction* t_outdated = container_of((struct binder_work*)reclaim, struct binder_transaction, work);
+      struct binder_proc* proc = binder_transaction_to_proc(t_outdated);
+      if (proc == alive || binder_proc_alive(proc, reclaim->pid)) {
+        alive = proc;
+        binder_free_outdated(proc, t_outdated, reclaim->buffer);
+      } else {
+        // 进程已释放, buffer 随 binder_alloc 一起回收
+        rekernel_stat_inc(REKERNEL_STAT_TXN_FREED);
+        kfree(t_outdated);
+        binder_stats_deleted(BINDER_STAT_TRANSACTION);
+      }
+      reclaim = next;
+    }
+    mutex_unlock(kvar(binder_procs_lock));
+  }
+}
+
+struct binder_policy_rule {
+  int uid;        // appid, -1: 任意
+  uint32_t iface; // 0: 任意
+  int code;       // -1: 任意
+  uint32_t action;
+  uint32_t n;
+  uint32_t cap; // 0: 不限制 async_todo 长度
+};
+
+struct binder_policy {
+  uint32_t count;
+  struct binder_policy_rule rules[BINDER_POLICY_MAX];
+};
+
+// 双缓冲, 与网络过滤表相同
+static struct binder_policy binder_policies[2];
+static uint32_t binder_policy_refs[2];
+static uint32_t binder_policy_active;
+// 有规则指定接口时才读取消息头
+static unsigned long binder_policy_iface = UZERO;
+
+// 合并动作与队列上限分别取第一条匹配的规则, 接口未知时不匹配指定接口的规则
+static void binder_policy_lookup(uid_t uid, uint32_t iface, unsigned int code, uint32_t* action, uint32_t* n, uint32_t* cap) {
+  uint32_t index;
+  for (;;) {
+    index = smp_load_acquire(&binder_policy_active);
+    add_return_u32(&binder_policy_refs[index], 1);
+    smp_mb();
+    if (smp_load_acquire(&binder_policy_active) == index)
+      break;
+    add_return_u32(&binder_policy_refs[index], -1);
+  }
+
+  struct binder_policy* policy = &binder_policies[index];
+  bool found_action = false, found_cap = false;
+  *action = BINDER_ACTION_LEGACY;
+  *n = 0;
+  *cap = 0;
+  for (uint32_t i = 0; i < policy->count && !(found_action && found_cap); i++) {
+    struct binder_policy_rule* rule = &policy->rules[i];
+    if ((rule->uid >= 0 && rule->uid != uid % PER_USER_RANGE) || (rule->iface && rule->iface != iface) ||
+        (rule->code >= 0 && rule->code != code))
+      continue;
+    if (rule->cap) {
+      if (!found_cap)
+        *cap = rule->cap;
+      found_cap = true;
+    } else if (!found_action) {
+      *action = rule->action;
+      *n = rule->n;
+      found_action = true;
+    }
+  }
+  add_return_u32(&binder_policy_refs[index], -1);
+}
+
+// 规则格式: uid:iface:code:action, action 为 legacy, exempt, last:n, first:n, cap:n, 多条规则以 ; 分隔
+// uid, iface 与 code 为 * 表示任意, iface 为描述符或 0x 开头的哈希
+static long binder_policy_parse_rule(char* value, struct binder_policy_rule* rule) {
+  char* p = value;
+  char* uid = p;
+  while (*p && *p != ':')
+    p++;
+  if (*p != ':')
+    return -EINVAL;
+  *p++ = '\0';
+  char* iface = p;
+  while (*p && *p != ':')
+    p++;
+  if (*p != ':')
+    return -EINVAL;
+  *p++ = '\0';
+  char* code = p;
+  while (*p && *p != ':')
+    p++;
+  if (*p != ':')
+    return -EINVAL;
+  *p++ = '\0';
+  char* action = p;
+  while (*p && *p != ':')
+    p++;
+  char* n = NULL;
+  if (*p == ':') {
+    *p++ = '\0';
+    n = p;
+  }
+
+  memset(rule, 0, sizeof(*rule));
+  rule->uid = -1;
+  if (strcmp(uid, "*")) {
+    if (kstrtoint(uid, 0, &rule->uid))
+      return -EINVAL;
+    if (rule->uid < 0)
+      return -ERANGE;
+    rule->uid %= PER_USER_RANGE;
+  }
+  if (strcmp(iface, "*") && binder_iface_parse(iface, &rule->iface))
+    return -EINVAL;
+  rule->code = -1;
+  if (strcmp(code, "*")) {
+    if (kstrtoint(code, 0, &rule->code))
+      return -EINVAL;
+    if (rule->code < 0)
+      return -ERANGE;
+  }
+
+  int val = 0;
+  if (n && kstrtoint(n, 0, &val))
+    return -EINVAL;
+  if (!strcmp(action, "legacy") || !strcmp(action, "exempt")) {
+    if (n)
+      return -EINVAL;
+    rule->action = action[0] == 'l' ? BINDER_ACTION_LEGACY : BINDER_ACTION_EXEMPT;
+    return 0;
+  }
+  if (!n || val < 1 || val > 65536)
+    return n ? -ERANGE : -EINVAL;
+  if (!strcmp(action, "last")) {
+    rule->action = BINDER_ACTION_LAST;
+    rule->n = val;
+  } else if (!strcmp(action, "first")) {
+    rule->action = BINDER_ACTION_FIRST;
+    rule->n = val;
+  } else if (!strcmp(action, "cap")) {
+    rule->cap = val;
+  } else {
+    return -EINVAL;
+  }
+  return 0;
+}
+
+static long binder_set_policy(char* value) {
+  uint32_t index = smp_load_acquire(&binder_policy_active) ^ 1;
+  struct binder_policy* policy = &binder_policies[index];
+
+  // 等待仍在使用旧策略的读者
+  smp_mb();
+  while (smp_load_acquire(&binder_policy_refs[index]))
+    schedule_timeout_interruptible(1);
+
+  policy->count = 0;
+  bool iface = false;
+  if (strcmp(value, "off")) {
+    char* p = value;
+    while (*p) {
+      char* rule = p;
+      while (*p && *p != ';')
+        p++;
+      if (*p)
+        *p++ = '\0';
+      if (!*rule)
+        continue;
+      if (policy->count >= BINDER_POLICY_MAX)
+        return -E2BIG;
+      long rc = binder_policy_parse_rule(rule, &policy->rules[policy->count]);
+      if (rc < 0)
+        return rc;
+      iface |= policy->rules[policy->count].iface != 0;
+      policy->count++;
+    }
+  }
+  smp_store_release(&binder_policy_active, index);
+  binder_policy_iface = iface ? IZERO : UZERO;
+  return 0;
+}
+
+// 摘除后的消息交给回收链表
+static void binder_drop_transaction(struct binder_proc* proc, struct binder_transaction* t_outdated) {
+  struct binder_buffer* buffer = binder_transaction_buffer(t_outdated);
+#ifdef CONFIG_DEBUG
+  logkm("free_outdated pid=%d,uid=%d,data_size=%d\n", proc->pid, task_uid(proc->tsk).val, buffer->data_size);
+#endif /* CONFIG_DEBUG */
+
+  * (struct binder_buffer**)((uintptr_t)t_outdated + binder_transaction_buffer_offset) = NULL;
+  buffer->transaction = NULL;
+  // 没有 binder_procs 时无法确认目标进程存活, 直接释放
+  if (kvar(binder_procs) && kvar(binder_procs_lock) && rekernel_worker_task) {
+    binder_reclaim_push(proc, t_outdated, buffer);
+  } else {
+    binder_free_outdated(proc, t_outdated, buffer);
+  }
+}
+
+static inline void binder_drop_add(struct binder_transaction** drops, uint32_t* nr_drops, struct binder_transaction* t) {
+  for (uint32_t i = 0; i < *nr_drops; i++) {
+    if (drops[i] == t)
+      return;
+  }
+  if (*nr_drops < BINDER_DROP_MAX)
+    drops[(*nr_drops)++] = t;
+}
+
+// 遍历 proc->nodes 前确认 binder_node->proc 指回该进程, 偏移不符时只提示一次
+static uint32_t binder_node_offset_warned;
+static inline bool binder_node_check(struct binder_node* node, struct binder_proc* proc) {
+  if (likely(*(struct binder_proc**)((uintptr_t)node + binder_node_proc_offset) == proc))
+    return true;
+  if (!xchg_u32(&binder_node_offset_warned, 1))
+    logkm("binder_node->proc mismatch, rb_node_offset=0x%llx, proc_offset=0x%llx\n", binder_node_rb_node_offset, binder_node_proc_offset);
+  return false;
+}
+
+struct binder_compact_slot {
+  unsigned int code;
+  unsigned int flags;
+  pid_t pid;
+  uint32_t total;
+  uint64_t payload;
+  uint32_t seen;
+  uint32_t action; // 按 code 查得的策略, 每个键只查一次
+  uint32_t n;
+  uint32_t cap;
+  bool used;
+};
+
+// 只在 worker 中使用, 按队列长度增长: slots 为不少于两倍长度的 2 的幂, 每个键都有位置, index 记录每条消息的 slot
+struct binder_compact_buf {
+  uint32_t cap;
+  uint32_t size;
+  struct binder_compact_slot* slots;
+  uint32_t* index;
+};
+static struct binder_compact_buf binder_compact_buf;
+
+static long binder_compact_grow(uint32_t len) {
+  uint32_t cap = BINDER_COMPACT_MIN;
+  while (cap < len)
+    cap <<= 1;
+  uint32_t size = cap << 1;
+  void* mem = vmalloc(size * sizeof(struct binder_compact_slot) + cap * sizeof(uint32_t));
+  if (!mem)
+    return -ENOMEM;
+  if (binder_compact_buf.slots)
+    vfree(binder_compact_buf.slots);
+  binder_compact_buf.cap = cap;
+  binder_compact_buf.size = size;
+  binder_compact_buf.slots = (struct binder_compact_slot*)mem;
+  binder_compact_buf.index = (uint32_t*)((uintptr_t)mem + size * sizeof(struct binder_compact_slot));
+  return 0;
+}
+
+static uint32_t binder_compact_slot(uid_t uid, uint32_t iface, struct binder_transaction* t, uint64_t payload) {
+  unsigned int code = binder_transaction_code(t);
+  unsigned int flags = binder_transaction_flags(t);
+  pid_t pid = binder_transaction_sender_pid(t);
+  uint32_t mask = binder_compact_buf.size - 1;
+  uint64_t key = ((uint64_t)code << 32) ^ ((uint64_t)flags << 16) ^ (uint32_t)pid ^ payload;
+  uint32_t hash = (key * 0x9E3779B97F4A7C15ULL) >> 32;
+  // 键数不超过消息数, 不超过 size 的一半, 一定能找到
+  for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+    struct binder_compact_slot* slot = &binder_compact_buf.slots[i];
+    if (!slot->used) {
+      slot->used = true;
+      slot->code = code;
+      slot->flags = flags;
+      slot->pid = pid;
+      slot->payload = payload;
+      slot->total = 0;
+      slot->seen = 0;
+      binder_policy_lookup(uid, iface, code, &slot->action, &slot->n, &slot->cap);
+      return i;
+    }
+    if (slot->code == code && slot->flags == flags && slot->pid == pid && slot->payload == payload)
+      return i;
+  }
+}
+
+// 比较内容时使用入队时记录的指纹, 没有记录的消息不合并
+static uint64_t binder_compact_payload(struct binder_txn_index* index, struct binder_node* node, struct binder_transaction* t) {
+  if (binder_payload == UZERO)
+    return 0;
+  if (!index)
+    return binder_payload_unknown(t);
+  return binder_txn_payload_of(index, index->min_seq, node, t);
+}
+
+// 按合并策略一次性压缩一个 async_todo, 从新到旧判断, 被丢弃的消息移到 dropped
+// 第一遍为每条消息确定 slot, 第二遍直接使用, 每条消息只散列一次
+static void binder_compact_list(struct binder_proc* proc, struct binder_node* node, struct list_head* async_todo, struct list_head* dropped) {
+  uid_t uid = task_uid(proc->tsk).val;
+  struct binder_txn_index* index = binder_txn_index ? binder_txn_shard(proc->pid) : NULL;
+  struct list_head* entry;
+  uint32_t i = 0;
+
+  // 同一节点的消息属于同一接口, 最多尝试前 4 条消息读取描述符
+  uint32_t iface = 0;
+  if (binder_policy_iface != UZERO) {
+    for (entry = async_todo->next; entry != async_todo && !iface && i < 4; entry = entry->next, i++)
+      iface = binder_interface_hash(container_of(entry, struct binder_transaction, work.entry));
+    i = 0;
+  }
+
+  memset(binder_compact_buf.slots, 0, binder_compact_buf.size * sizeof(struct binder_compact_slot));
+  if (index)
+    spin_lock(&index->lock);
+  for (entry = async_todo->next; entry != async_todo; entry = entry->next, i++) {
+    struct binder_transaction* t = container_of(entry, struct binder_transaction, work.entry);
+    uint32_t slot = binder_compact_slot(uid, iface, t, binder_compact_payload(index, node, t));
+    binder_compact_buf.index[i] = slot;
+    binder_compact_buf.slots[slot].total++;
+  }
+  if (index)
+    spin_unlock(&index->lock);
+
+  uint32_t kept = 0;
+  for (entry = async_todo->prev; entry != async_todo && i > 0;) {
+    struct list_head* prev = entry->prev;
+    struct binder_transaction* t = container_of(entry, struct binder_transaction, work.entry);
+    struct binder_compact_slot* slot = &binder_compact_buf.slots[binder_compact_buf.index[--i]];
+
+    bool drop = false;
+    uint32_t newest = slot->seen++;
+    uint32_t oldest = slot->total - 1 - newest;
+    if (slot->action == BINDER_ACTION_LEGACY) {
+      drop = newest && oldest;
+    } else if (slot->action == BINDER_ACTION_LAST) {
+      drop = newest >= slot->n;
+    } else if (slot->action == BINDER_ACTION_FIRST) {
+      drop = oldest >= slot->n;
+    }
+    if (!drop && slot->cap && kept >= slot->cap)
+      drop = true;
+
+    if (drop) {
+      list_del_init(entry);
+      list_add_tail(entry, dropped);
+      outstanding_txns_dec(proc);
+      binder_txn_forget(proc, t);
+    } else {
+      kept++;
+    }
+    entry = prev;
+  }
+}
+
+// proc->nodes 按 ptr 排序, 释放 inner_lock 后节点可能已被释放, 按上次的 ptr 重新查找下一个
+static struct binder_node* binder_compact_next(struct binder_proc* proc, bool started, binder_uintptr_t after) {
+  struct rb_node* n = proc->nodes.rb_node;
+  struct binder_node* next = NULL;
+  while (n) {
+    struct binder_node* node = (struct binder_node*)((uintptr_t)n - binder_node_rb_node_offset);
+    if (!started || binder_node_ptr(node) > after) {
+      next = node;
+      n = n->rb_left;
+    } else {
+      n = n->rb_right;
+    }
+  }
+  return next;
+}
+
+static inline uint32_t binder_compact_len(struct list_head* async_todo) {
+  uint32_t len = 0;
+  struct list_head* entry;
+  for (entry = async_todo->next; entry != async_todo && len <= BINDER_COMPACT_MAX; entry = entry->next)
+    len++;
+  return len;
+}
+
+static void binder_compact_free(struct binder_proc* proc, struct list_head* dropped) {
+  while (!list_empty(dropped)) {
+    struct binder_transaction* t_outdated = container_of(dropped->next, struct binder_transaction, work.entry);
+    list_del_init(&t_outdated->work.entry);
+    struct binder_buffer* buffer = binder_transaction_buffer(t_outdated);
+    * (struct binder_buffer**)((uintptr_t)t_outdated + binder_transaction_buffer_offset) = NULL;
+    buffer->transaction = NULL;
+    binder_free_outdated(proc, t_outdated, buffer);
+  }
+}
+
+// 调用时持有 binder_procs_lock, 进程不会被释放. 每个节点单独持有 inner_lock, 不阻塞其他节点的收发
+static void binder_compact_proc(struct binder_proc* proc) {
+  struct list_head dropped;
+  INIT_LIST_HEAD(&dropped);
+
+  bool started = false;
+  binder_uintptr_t after = 0;
+  for (;;) {
+    binder_inner_proc_lock(proc);
+    struct binder_node* node = binder_compact_next(proc, started, after);
+    // 偏移不符时放弃
+    if (!node || !binder_node_check(node, proc)) {
+      binder_inner_proc_unlock(proc);
+      break;
+    }
+    binder_uintptr_t ptr = binder_node_ptr(node);
+    struct list_head* async_todo = binder_node_async_todo(node);
+    uint32_t len = binder_compact_len(async_todo);
+    if (len >= 2 && len <= BINDER_COMPACT_MAX && len > binder_compact_buf.cap) {
+      // 解锁后扩容, 再重新查找同一节点
+      binder_inner_proc_unlock(proc);
+      if (binder_compact_grow(len) < 0) {
+        rekernel_stat_inc(REKERNEL_STAT_ALLOC_FAIL);
+        rekernel_stat_inc(REKERNEL_STAT_COMPACT_SKIPPED);
+        started = true;
+        after = ptr;
+      }
+      continue;
+    }
+    if (len > BINDER_COMPACT_MAX) {
+      rekernel_stat_inc(REKERNEL_STAT_COMPACT_SKIPPED);
+    } else if (len >= 2) {
+      binder_compact_list(proc, node, async_todo, &dropped);
+    }
+    binder_inner_proc_unlock(proc);
+    started = true;
+    after = ptr;
+  }
+  binder_compact_free(proc, &dropped);
+}
+
+struct binder_compact_target {
+  struct binder_proc* proc;
+  pid_t pid;
+  uid_t uid;
+};
+static struct binder_compact_target binder_compact_targets[BINDER_COMPACT_TARGETS];
+
+// 先在 binder_procs_lock 下选出目标进程, 再逐个重新加锁确认存活后压缩, 不在整轮期间持有该锁
+static void binder_compact_pending(void) {
+  static uint64_t mask[FROZEN_UID_WORDS];
+
+  uint32_t any = xchg_u32(&rekernel_compact_pending_any, 0);
+  if (!any)
+    return;
+  if (!kvar(binder_procs) || !kvar(binder_procs_lock) || binder_node_ptr_offset == UZERO)
+    return;
+  for (int i = 0; i < FROZEN_UID_WORDS; i++)
+    mask[i] = xchg_u64(&rekernel_compact_pending[i], 0);
+
+  uint32_t count = 0;
+  mutex_lock(kvar(binder_procs_lock));
+  struct hlist_node* node;
+  for (node = kvar(binder_procs)->first; node; node = node->next) {
+    struct binder_proc* proc = container_of(node, struct binder_proc, proc_node);
+    struct task_struct* tsk = proc->tsk;
+    if (!tsk)
+      continue;
+    uid_t uid = task_uid(tsk).val;
+    uint32_t index = uid % PER_USER_RANGE;
+    if (index < MIN_USERAPP_UID)
+      continue;
+    index -= MIN_USERAPP_UID;
+    if (any == 1 && !((mask[index / 64] >> (index % 64)) & 1))
+      continue;
+    // binder 冻结时由内核处理, 与发送路径的判断一致
+    if (binder_is_frozen(proc) || !frozen_task_group(tsk))
+      continue;
+    // 超出的进程留到下一轮
+    if (count >= BINDER_COMPACT_TARGETS) {
+      rekernel_compact_request(uid, 1);
+      continue;
+    }
+    binder_compact_targets[count].proc = proc;
+    binder_compact_targets[count].pid = proc->pid;
+    binder_compact_targets[count].uid = uid;
+    count++;
+  }
+  mutex_unlock(kvar(binder_procs_lock));
+
+  for (uint32_t i = 0; i < count; i++) {
+    struct binder_proc* proc = binder_compact_targets[i].proc;
+    mutex_lock(kvar(binder_procs_lock));
+    if (binder_proc_alive(proc, binder_compact_targets[i].pid) && proc->tsk && !binder_is_frozen(proc))
+      binder_compact_proc(proc);
+    mutex_unlock(kvar(binder_procs_lock));
+  }
+}
+
+// 统计所有 binder node 的 async_todo, 调用时持有 binder_procs_lock
+static void binder_async_stat(struct binder_proc* proc, uint32_t* count, size_t* bytes) {
+  *count = 0;
+  *bytes = 0;
+  if (binder_node_ptr_offset == UZERO)
+    return;
+
+  binder_inner_proc_lock(proc);
+  struct rb_node* n;
+  for (n = rb_first(&proc->nodes); n; n = rb_next(n)) {
+    struct binder_node* node = (struct binder_node*)((uintptr_t)n - binder_node_rb_node_offset);
+    if (!binder_node_check(node, proc))
+      break;
+    struct list_head* async_todo = binder_node_async_todo(node);
+    struct list_head* entry;
+    for (entry = async_todo->next; entry != async_todo; entry = entry->next) {
+      struct binder_transaction* t = container_of(entry, struct binder_transaction, work.entry);
+      struct binder_buffer* buffer = binder_transaction_buffer(t);
+      (*count)++;
+      if (buffer)
+        *bytes += buffer->data_size + buffer->offsets_size + buffer->extra_buffers_size;
+    }
+  }
+  binder_inner_proc_unlock(proc);
+}
+
+// 每个冻结进程一行: pid uid free_async_space buffer_size async_count async_bytes
+static size_t binder_async_snapshot(char* snapshot) {
+  size_t len = snprintf(snapshot, ASYNC_SNAPSHOT_SIZE, "pid uid free_async_space buffer_size async_count async_bytes\n");
+  mutex_lock(kvar(binder_procs_lock));
+  struct hlist_node* node;
+  for (node = kvar(binder_procs)->first; node && len < ASYNC_SNAPSHOT_SIZE; node = node->next) {
+    struct binder_proc* proc = container_of(node, struct binder_proc, proc_node);
+    struct task_struct* tsk = proc->tsk;
+    if (!tsk || task_uid(tsk).val % PER_USER_RANGE < MIN_USERAPP_UID)
+      continue;
+    if (!rekernel_task_frozen(tsk))
+      continue;
+
+    struct binder_alloc* alloc = binder_proc_alloc(proc);
+    uint32_t async_count;
+    size_t async_bytes;
+    binder_async_stat(proc, &async_count, &async_bytes);
+    len += snprintf(snapshot + len, ASYNC_SNAPSHOT_SIZE - len, "%d %d %zu %zu %u %zu\n", proc->pid, task_uid(tsk).val,
+      binder_alloc_free_async_space(alloc), binder_alloc_buffer_size(alloc), async_count, async_bytes);
+  }
+  mutex_unlock(kvar(binder_procs_lock));
+  if (len > ASYNC_SNAPSHOT_SIZE - 1)
+    len = ASYNC_SNAPSHOT_SIZE - 1;
+  return len;
+}
+
+// 快照在 *ppos 为 0 时生成, 同一次打开的后续分段读取使用同一份, 行不会在两份快照之间错位
+// 不 hook release, 只保留最近一个文件的快照, 被其他读者替换后才重新生成
+static uint32_t binder_async_cache_lock;
+static struct file* binder_async_cache_file;
+static char* binder_async_cache;
+static size_t binder_async_cache_len;
+
+static ssize_t binder_async_snapshot_read(struct file* file, char __user* buf, size_t count, loff_t* ppos) {
+  while (cmpxchg_u32(&binder_async_cache_lock, 0, 1) != 0)
+    schedule_timeout_interruptible(1);
+  if (!binder_async_cache)
+    binder_async_cache = vmalloc(ASYNC_SNAPSHOT_SIZE);
+  ssize_t copied = -ENOMEM;
+  if (binder_async_cache) {
+    if (*ppos == 0 || binder_async_cache_file != file) {
+      binder_async_cache_len = binder_async_snapshot(binder_async_cache);
+      binder_async_cache_file = file;
+    }
+    copied = rekernel_snapshot_copy(buf, count, ppos, binder_async_cache, binder_async_cache_len);
+  }
+  smp_store_release(&binder_async_cache_lock, 0);
+  return copied;
+}
+
+static void __binder_proc_transaction_before(hook_fargs3_t* args, void* udata) {
+  struct binder_transaction* t = (struct binder_transaction*)args->arg0;
+  struct binder_proc* proc = (struct binder_proc*)args->arg1;
+  args->local.data0 = 0;
+
+  struct binder_buffer* buffer = binder_transaction_buffer(t);
+  struct binder_node* node = buffer->target_node;
+  unsigned int flags = binder_transaction_flags(t);
+  // 兼容不支持 trace 的内核, 需要接口描述符时同步消息与 overflow 也在此报告
+  if (trace == UZERO || binder_iface_wanted()) {
+    rekernel_binder_transaction(NULL, false, t, NULL);
+  }
+  if (!node || !(flags & TF_ONE_WAY))
+    return;
+
+  // binder 冻结时不再清理过时消息
+  if (binder_is_frozen(proc)) {
+    if ((flags & TF_UPDATE_TXN) && binder_txn_index) {
+      struct binder_txn_index* index = binder_txn_shard(proc->pid);
+      spin_lock(&index->lock);
+      binder_txn_drop(index, node, binder_transaction_code(t), flags, binder_transaction_sender_pid(t));
+      spin_unlock(&index->lock);
+    }
+    return;
+  }
+  if (!rekernel_task_frozen(proc->tsk))
+    return;
+
+  uint32_t action, n, cap;
+  uint32_t iface = binder_policy_iface != UZERO ? binder_interface_hash(t) : 0;
+  binder_policy_lookup(task_uid(proc->tsk).val, iface, binder_transaction_code(t), &action, &n, &cap);
+  if (action == BINDER_ACTION_EXEMPT && !cap)
+    return;
+  // 在加锁前计算内容指纹
+  uint64_t payload = binder_transaction_payload(t);
+
+  binder_node_lock(node);
+  bool has_async_transaction = binder_node_has_async_transaction(node);
+  if (!has_async_transaction) {
+    binder_node_unlock(node);
+    return;
+  }
+  binder_inner_proc_lock(proc);
+
+  struct list_head* async_todo = binder_node_async_todo(node);
+  struct binder_transaction* drops[BINDER_DROP_MAX];
+  struct binder_transaction* matches[BINDER_DROP_MAX];
+  uint32_t nr_drops = 0, count = 0;
+  bool drop_new = false;
+
+  if (action != BINDER_ACTION_EXEMPT)
+    count = binder_collect_outdated(t, payload, proc, node, async_todo, matches, BINDER_DROP_MAX);
+  if (action == BINDER_ACTION_LEGACY) {
+    if (count >= 2)
+      binder_drop_add(drops, &nr_drops, matches[1]);
+  } else if (action == BINDER_ACTION_LAST) {
+    // 加上新消息后保留 n 条
+    for (uint32_t i = 0; i + n <= count && i < BINDER_DROP_MAX; i++)
+      binder_drop_add(drops, &nr_drops, matches[i]);
+  } else if (action == BINDER_ACTION_FIRST) {
+    drop_new = count >= n;
+  }
+
+  // 超过队列上限时从队首丢弃, 最多遍历 cap + BINDER_DROP_MAX 项
+  if (cap) {
+    struct list_head* entry = async_todo->next;
+    uint32_t len = 0;
+    while (entry != async_todo && len < cap + BINDER_DROP_MAX) {
+      entry = entry->next;
+      len++;
+    }
+    entry = async_todo->next;
+    for (uint32_t i = 0; i + cap <= len && entry != async_todo; i++) {
+      binder_drop_add(drops, &nr_drops, container_of(entry, struct binder_transaction, work.entry));
+      entry = entry->next;
+    }
+  }
+
+  for (uint32_t i = 0; i < nr_drops; i++) {
+    list_del_init(&drops[i]->work.entry);
+    outstanding_txns_dec(proc);
+    binder_txn_forget(proc, drops[i]);
+  }
+
+  binder_inner_proc_unlock(proc);
+  binder_node_unlock(node);
+
+  // 入队后再加入索引或丢弃新消息
+  args->local.data0 = (uint64_t)node;
+  args->local.data1 = binder_transaction_code(t);
+  args->local.data2 = flags;
+  args->local.data3 = binder_transaction_sender_pid(t);
+  args->local.data4 = drop_new;
+  args->local.data5 = payload;
+
+  for (uint32_t i = 0; i < nr_drops; i++)
+    binder_drop_transaction(proc, drops[i]);
+}
+
+// t 可能已被处理并释放, 只有仍在 async_todo 队尾时才加入索引
+static void binder_proc_transaction_after(hook_fargs3_t* args, void* udata) {
+  struct binder_node* node = (struct binder_node*)args->local.data0;
+  bool drop_new = args->local.data4;
+  if (!node || (!binder_txn_index && !drop_new))
+    return;
+  struct binder_transaction* t = (struct binder_transaction*)args->arg0;
+  struct binder_proc* proc = (struct binder_proc*)args->arg1;
+
+  binder_node_lock(node);
+  binder_inner_proc_lock(proc);
+  struct list_head* async_todo = binder_node_async_todo(node);
+  bool queued = async_todo->prev == &t->work.entry && binder_transaction_code(t) == args->local.data1 && binder_transaction_flags(t) == args->local.data2;
+  if (queued && drop_new) {
+    list_del_init(&t->work.entry);
+    outstanding_txns_dec(proc);
+  } else if (queued) {
+    struct binder_txn_index* index = binder_txn_shard(proc->pid);
+    spin_lock(&index->lock);
+    binder_txn_insert(index, t, node, args->local.data1, args->local.data2, args->local.data3, args->local.data5);
+    spin_unlock(&index->lock);
+  }
+  binder_inner_proc_unlock(proc);
+  binder_node_unlock(node);
+
+  if (queued && drop_new)
+    binder_drop_transaction(proc, t);
+}
+
+static void binder_proc_transaction_before(hook_fargs3_t* args, void* udata) {
+  uint64_t start = rekernel_latency_begin();
+  __binder_proc_transaction_before(args, udata);
+  rekernel_latency_end(LATENCY_BINDER_PROC_TRANSACTION, start);
+}
+
+static void do_send_sig_info_before(hook_fargs4_t* args, void* udata) {
+  uint64_t start = rekernel_latency_begin();
+  int sig = (int)args->arg0;
+  struct task_struct* dst = (struct task_struct*)args->arg2;
+
+  if (sig == SIGKILL || sig == SIGTERM || sig == SIGABRT || sig == SIGQUIT) {
+    rekernel_report(SIGNAL, sig, task_tgid(current), current, task_tgid(dst), dst, false, NULL);
+  }
+  rekernel_latency_end(LATENCY_SEND_SIG_INFO, start);
+}
+
+#ifdef CONFIG_NETWORK
+static inline bool sk_fullsock(const struct sock* sk) {
+  return (1 << sk->sk_state) & ~(TCPF_TIME_WAIT | TCPF_NEW_SYN_RECV);
+}
+
+// sock_i_uid 需要获取 sk_callback_lock, sk_uid 不需要加锁, 与 sock_net_uid 相同
+static uid_t sock_uid(struct sock* sk) {
+  if (sock_sk_uid_offset == UZERO)
+    return sock_i_uid(sk).val;
+  return *(volatile uid_t*)((uintptr_t)sk + sock_sk_uid_offset);
+}
+
+// 同一 uid 在窗口内只报告一次, 其余计入 suppressed
+static bool rekernel_net_coalesce(uid_t uid) {
+  if (rekernel_net_window == UZERO)
+    return true;
+  struct rekernel_uid_slot* slot = rekernel_uid_slot(uid, true);
+  if (!slot)
+    return true;
+
+  uint32_t now = rekernel_jiffies();
+  uint32_t last = smp_load_acquire(&slot->net_last);
+  if ((last && now - last < rekernel_net_window_jiffies) || cmpxchg_u32(&slot->net_last, last, now) != last) {
+    add_return_u32(&slot->suppressed[REKERNEL_GROUP_NETWORK], 1);
+    return false;
+  }
+  return true;
+}
+
+struct rekernel_net_rule {
+  bool deny;
+  int uid;   // -1: 任意
+  int proto; // -1: 任意
+  uint32_t port[2][2]; // 本地/远端端口范围
+  uint32_t addr;       // 远端 IPv4 前缀, 主机字节序
+  uint32_t addr_len;   // 0: 任意
+};
+
+// 每个维度对应一个规则位集, 端口按区间划分为等价类, 地址按前缀长度分别查表
+struct rekernel_net_table {
+  uint64_t deny;
+  uint64_t any_uid;
+  uint64_t proto[NET_PROTO_MAX];
+  uid_t uid_keys[NET_FILTER_SLOTS];
+  uint64_t uid_masks[NET_FILTER_SLOTS];
+  uint64_t addr_any;
+  uint32_t nr_lens;
+  uint32_t lens[33];
+  uint32_t addr_keys[NET_FILTER_SLOTS];
+  uint32_t addr_key_lens[NET_FILTER_SLOTS];
+  uint64_t addr_masks[NET_FILTER_SLOTS];
+  uint64_t port_masks[2][NET_FILTER_CLASSES];
+  uint8_t port_class[2][65536];
+};
+
+// 双缓冲, 读者持有引用期间写者不会重建该表
+static struct rekernel_net_table* rekernel_net_tables[2];
+static uint32_t rekernel_net_table_refs[2];
+static uint32_t rekernel_net_table_active = NET_FILTER_NONE;
+static struct rekernel_net_rule rekernel_net_rules[NET_FILTER_MAX];
+
+static inline uint32_t rekernel_net_hash(uint32_t key, uint32_t len) {
+  return ((key ^ (len << 24)) * 0x9E3779B9) >> 25;
+}
+
+static inline uint32_t rekernel_net_prefix(uint32_t addr, uint32_t len) {
+  return len ? addr & ~((1ULL << (32 - len)) - 1) : 0;
+}
+
+static uint64_t rekernel_net_uid_mask(struct rekernel_net_table* table, uid_t uid) {
+  uint32_t hash = rekernel_net_hash(uid, 0);
+  for (uint32_t i = 0; i < NET_FILTER_SLOTS; i++) {
+    uint32_t index = (hash + i) % NET_FILTER_SLOTS;
+    if (!table->uid_masks[index])
+      return 0;
+    if (table->uid_keys[index] == uid)
+      return table->uid_masks[index];
+  }
+  return 0;
+}
+
+static uint64_t rekernel_net_addr_mask(struct rekernel_net_table* table, uint32_t key, uint32_t len) {
+  uint32_t hash = rekernel_net_hash(key, len);
+  for (uint32_t i = 0; i < NET_FILTER_SLOTS; i++) {
+    uint32_t index = (hash + i) % NET_FILTER_SLOTS;
+    if (!table->addr_masks[index])
+      return 0;
+    if (table->addr_keys[index] == key && table->addr_key_lens[index] == len)
+      return table->addr_masks[index];
+  }
+  return 0;
+}
+
+// 没有规则命中时报告
+static bool rekernel_net_table_match(struct rekernel_net_table* table, struct sock* sk, uid_t uid, int proto) {
+  uint64_t mask = table->proto[proto] & (table->any_uid | rekernel_net_uid_mask(table, uid));
+  mask &= table->port_masks[0][table->port_class[0][sk->sk_num]];
+  mask &= table->port_masks[1][table->port_class[1][__builtin_bswap16(sk->sk_dport)]];
+  if (!mask)
+    return true;
+
+  uint64_t addr_mask = table->addr_any;
+  if (sk->sk_family == AF_INET) {
+    uint32_t addr = __builtin_bswap32(sk->sk_daddr);
+    for (uint32_t i = 0; i < table->nr_lens; i++) {
+      uint32_t len = table->lens[i];
+      addr_mask |= rekernel_net_addr_mask(table, rekernel_net_prefix(addr, len), len);
+    }
+  }
+  mask &= addr_mask;
+  if (!mask)
+    return true;
+  return !(table->deny & (mask & -mask));
+}
+
+static bool rekernel_net_allowed(struct sock* sk, uid_t uid, int proto) {
+  uint32_t index;
+  for (;;) {
+    index = smp_load_acquire(&rekernel_net_table_active);
+    if (index == NET_FILTER_NONE)
+      return true;
+    add_return_u32(&rekernel_net_table_refs[index], 1);
+    smp_mb();
+    if (smp_load_acquire(&rekernel_net_table_active) == index)
+      break;
+    add_return_u32(&rekernel_net_table_refs[index], -1);
+  }
+  bool allowed = rekernel_net_table_match(rekernel_net_tables[index], sk, uid, proto);
+  add_return_u32(&rekernel_net_table_refs[index], -1);
+  return allowed;
+}
+
+static void rekernel_net_build_ports(struct rekernel_net_table* table, uint32_t dir, uint32_t count) {
+  uint32_t bounds[NET_FILTER_MAX * 2 + 1];
+  uint32_t nr_bounds = 0, nr_classes = 0;
+
+  bounds[nr_bounds++] = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    bounds[nr_bounds++] = rekernel_net_rules[i].port[dir][0];
+    bounds[nr_bounds++] = rekernel_net_rules[i].port[dir][1] + 1;
+  }
+  for (uint32_t i = 1; i < nr_bounds; i++) {
+    uint32_t bound = bounds[i], j = i;
+    for (; j > 0 && bounds[j - 1] > bound; j--)
+      bounds[j] = bounds[j - 1];
+    bounds[j] = bound;
+  }
+
+  for (uint32_t i = 0; i < nr_bounds; i++) {
+    uint32_t start = bounds[i], end = i + 1 < nr_bounds ? bounds[i + 1] : 65536;
+    if (start >= 65536)
+      break;
+    if (start == end)
+      continue;
+
+    uint64_t mask = 0;
+    for (uint32_t j = 0; j < count; j++) {
+      if (rekernel_net_rules[j].port[dir][0] <= start && start <= rekernel_net_rules[j].port[dir][1])
+        mask |= 1ULL << j;
+    }
+    uint32_t class = 0;
+    while (class < nr_classes && table->port_masks[dir][class] != mask)
+      class++;
+    if (class == nr_classes)
+      table->port_masks[dir][nr_classes++] = mask;
+    memset(&table->port_class[dir][start], class, end - start);
+  }
+}
+
+static void rekernel_net_build(struct rekernel_net_table* table, uint32_t count) {
+  memset(table, 0, sizeof(*table));
+  for (uint32_t i = 0; i < count; i++) {
+    struct rekernel_net_rule* rule = &rekernel_net_rules[i];
+    uint64_t bit = 1ULL << i;
+
+    if (rule->deny)
+      table->deny |= bit;
+    for (uint32_t proto = 0; proto < NET_PROTO_MAX; proto++) {
+      if (rule->proto < 0 || rule->proto == proto)
+        table->proto[proto] |= bit;
+    }
+
+    if (rule->uid < 0) {
+      table->any_uid |= bit;
+    } else {
+      uint32_t index = rekernel_net_hash(rule->uid, 0);
+      while (table->uid_masks[index] && table->uid_keys[index] != rule->uid)
+        index = (index + 1) % NET_FILTER_SLOTS;
+      table->uid_keys[index] = rule->uid;
+      table->uid_masks[index] |= bit;
+    }
+
+    if (!rule->addr_len) {
+      table->addr_any |= bit;
+    } else {
+      uint32_t j = 0;
+      while (j < table->nr_lens && table->lens[j] != rule->addr_len)
+        j++;
+      if (j == table->nr_lens)
+        table->lens[table->nr_lens++] = rule->addr_len;
+
+      uint32_t key = rekernel_net_prefix(rule->addr, rule->addr_len);
+      uint32_t index = rekernel_net_hash(key, rule->addr_len);
+      while (table->addr_masks[index] && (table->addr_keys[index] != key || table->addr_key_lens[index] != rule->addr_len))
+        index = (index + 1) % NET_FILTER_SLOTS;
+      table->addr_keys[index] = key;
+      table->addr_key_lens[index] = rule->addr_len;
+      table->addr_masks[index] |= bit;
+    }
+  }
+  rekernel_net_build_ports(table, 0, count);
+  rekernel_net_build_ports(table, 1, count);
+}
+
+static char* rekernel_net_field(char** p, char sep) {
+  char* field = *p;
+  while (**p && **p != sep)
+    (*p)++;
+  if (**p)
+    *(*p)++ = '\0';
+  return field;
+}
+
+static long rekernel_net_parse_port(char* value, uint32_t* range) {
+  if (!strcmp(value, "*")) {
+    range[0] = 0;
+    range[1] = 65535;
+    return 0;
+  }
+  char* end = value;
+  char* start = rekernel_net_field(&end, '-');
+  int lo, hi;
+  if (kstrtoint(start, 0, &lo) || kstrtoint(*end ? end : start, 0, &hi))
+    return -EINVAL;
+  if (lo < 0 || hi > 65535 || lo > hi)
+    return -ERANGE;
+  range[0] = lo;
+  range[1] = hi;
+  return 0;
+}
+
+static long rekernel_net_parse_addr(char* value, struct rekernel_net_rule* rule) {
+  rule->addr = 0;
+  rule->addr_len = 0;
+  if (!strcmp(value, "*"))
+    return 0;
+
+  char* p = value;
+  char* octets = rekernel_net_field(&p, '/');
+  int len = 32;
+  if (*p && kstrtoint(p, 0, &len))
+    return -EINVAL;
+  if (len < 0 || len > 32)
+    return -ERANGE;
+  for (int i = 0; i < 4; i++) {
+    int octet;
+    if (kstrtoint(rekernel_net_field(&octets, '.'), 0, &octet))
+      return -EINVAL;
+    if (octet < 0 || octet > 255)
+      return -ERANGE;
+    rule->addr = (rule->addr << 8) | octet;
+  }
+  if (*octets)
+    return -EINVAL;
+  rule->addr_len = len;
+  return 0;
+}
+
+// 规则格式: allow|deny:uid:proto:lport:rport:addr, 多条规则以 ; 分隔, 字段为 * 表示任意
+static long rekernel_net_parse_rule(char* value, struct rekernel_net_rule* rule) {
+  char* p = value;
+  char* verdict = rekernel_net_field(&p, ':');
+  char* uid = rekernel_net_field(&p, ':');
+  char* proto = rekernel_net_field(&p, ':');
+  char* lport = rekernel_net_field(&p, ':');
+  char* rport = rekernel_net_field(&p, ':');
+  char* addr = rekernel_net_field(&p, ':');
+  if (*p || !*addr)
+    return -EINVAL;
+
+  if (!strcmp(verdict, "allow")) {
+    rule->deny = false;
+  } else if (!strcmp(verdict, "deny")) {
+    rule->deny = true;
+  } else {
+    return -EINVAL;
+  }
+
+  rule->uid = -1;
+  if (strcmp(uid, "*")) {
+    if (kstrtoint(uid, 0, &rule->uid))
+      return -EINVAL;
+    if (rule->uid < 0)
+      return -ERANGE;
+  }
+
+  if (!strcmp(proto, "*")) {
+    rule->proto = -1;
+  } else if (!strcmp(proto, "tcp")) {
+    rule->proto = NET_PROTO_TCP;
+  } else if (!strcmp(proto, "udp")) {
+    rule->proto = NET_PROTO_UDP;
+  } else {
+    return -EINVAL;
+  }
+
+  long rc = rekernel_net_parse_port(lport, rule->port[0]);
+  if (rc < 0)
+    return rc;
+  rc = rekernel_net_parse_port(rport, rule->port[1]);
+  if (rc < 0)
+    return rc;
+  return rekernel_net_parse_addr(addr, rule);
+}
+
+static long rekernel_set_net_filter(char* value) {
+  if (!strcmp(value, "off")) {
+    smp_store_release(&rekernel_net_table_active, NET_FILTER_NONE);
+    return 0;
+  }
+
+  uint32_t count = 0;
+  char* p = value;
+  while (*p) {
+    char* rule = rekernel_net_field(&p, ';');
+    if (!*rule)
+      continue;
+    if (count >= NET_FILTER_MAX)
+      return -E2BIG;
+    long rc = rekernel_net_parse_rule(rule, &rekernel_net_rules[count]);
+    if (rc < 0)
+      return rc;
+    count++;
+  }
+
+  uint32_t active = smp_load_acquire(&rekernel_net_table_active);
+  uint32_t index = active == 0 ? 1 : 0;
+  if (!rekernel_net_tables[index]) {
+    rekernel_net_tables[index] = vmalloc(sizeof(struct rekernel_net_table));
+    if (!rekernel_net_tables[index])
+      return -ENOMEM;
+  }
+  // 等待仍在使用旧表的读者
+  smp_mb();
+  while (smp_load_acquire(&rekernel_net_table_refs[index]))
+    schedule_timeout_interruptible(1);
+  rekernel_net_build(rekernel_net_tables[index], count);
+  smp_store_release(&rekernel_net_table_active, index);
+  return 0;
+}
+
+// 接收队列未超过阈值时只记录积压开始的时间, 由 worker 在超过期限后报告
+static bool rekernel_net_backlogged(struct sock* sk, uid_t uid) {
+  if (rekernel_net_backlog == UZERO || sock_rmem_alloc_offset == UZERO)
+    return true;
+
+  struct rekernel_uid_slot* slot = rekernel_uid_slot(uid, true);
+  if (!slot)
+    return true;
+
+  int rmem = *(volatile int*)((uintptr_t)sk + sock_rmem_alloc_offset);
+  if (rmem >= (int)rekernel_net_backlog) {
+    if (slot->net_pending)
+      smp_store_release(&slot->net_pending, 0);
+    return true;
+  }
+  if (!smp_load_acquire(&slot->net_pending))
+    cmpxchg_u32(&slot->net_pending, 0, rekernel_jiffies() | 1);
+  return false;
+}
+
+static void rekernel_net_deadline_scan(void) {
+  if (rekernel_net_backlog == UZERO || rekernel_net_deadline == UZERO)
+    return;
+
+  uint32_t now = rekernel_jiffies();
+  for (int i = 0; i < UID_SLOT_SIZE; i++) {
+    struct rekernel_uid_slot* slot = &rekernel_uid_slots[i];
+    uint32_t pending = smp_load_acquire(&slot->net_pending);
+    if (!pending || now - pending < rekernel_net_deadline_jiffies)
+      continue;
+    if (cmpxchg_u32(&slot->net_pending, pending, 0) != pending)
+      continue;
+
+    uid_t uid = smp_load_acquire(&slot->key) - 1;
+    if (!rekernel_uid_maybe_frozen(uid) || !rekernel_net_coalesce(uid))
+      continue;
+    rekernel_report(NETWORK, NULL, NULL, NULL, uid, NULL, true, NULL);
+  }
+}
+
+// 网络事件只报告冻结的 uid, 没有冻结位图时无法快速判断, 全部报告
+static bool rekernel_net_filter(struct sock* sk, uid_t uid, int proto) {
+  if (uid < MIN_USERAPP_UID)
+    return false;
+  if (!rekernel_interested(uid, REKERNEL_GROUP_NETWORK)) {
+    rekernel_stat_inc(REKERNEL_STAT_FILTERED);
+    return false;
+  }
+  if (!rekernel_uid_maybe_frozen(uid))
+    return false;
+  if (!rekernel_net_allowed(sk, uid, proto)) {
+    rekernel_stat_inc(REKERNEL_STAT_FILTERED);
+    return false;
+  }
+  if (!rekernel_net_backlogged(sk, uid))
+    return false;
+  return rekernel_net_coalesce(uid);
+}
+
+static void __tcp_rcv_before(hook_fargs1_t* args, void* udata) {
+  struct sk_buff* skb = (struct sk_buff*)args->arg0;
+  struct sock* sk = skb->sk;;
+  if (sk == NULL || !sk_fullsock(sk))
+    return;
+
+  uid_t uid = sock_uid(sk);
+  if (!rekernel_net_filter(sk, uid, NET_PROTO_TCP))
+    return;
+
+  rekernel_report(NETWORK, NULL, NULL, NULL, uid, NULL, true, NULL);
 }
 
-static void binder_proc_transaction_before(hook_fargs3_t* args, void* udata) {
-  struct binder_transaction* t = (struct binder_transaction*)args->arg0;
-  struct binder_proc* proc = (struct binder_proc*)args->arg1;
+static void tcp_rcv_before(hook_fargs1_t* args, void* udata) {
+  uint64_t start = rekernel_latency_begin();
+  __tcp_rcv_before(args, udata);
+  rekernel_latency_end(LATENCY_TCP_RCV, start);
+}
 
-  struct binder_buffer* buffer = binder_transaction_buffer(t);
-  struct binder_node* node = buffer->target_node;
-  // 兼容不支持 trace 的内核
-  if (trace == UZERO) {
-    rekernel_binder_transaction(NULL, false, t, NULL);
-  }
-  unsigned int flags = binder_transaction_flags(t);
-  if (!node || !(flags & TF_ONE_WAY))
+// UDP (含 QUIC) 在数据进入接收队列时判断, 与 TCP 使用相同的过滤与合并
+static void __udp_enqueue_before(hook_fargs2_t* args, void* udata) {
+  struct sock* sk = (struct sock*)args->arg0;
+  if (rekernel_net_udp == UZERO)
     return;
 
-  // binder 冻结时不再清理过时消息
-  if (binder_is_frozen(proc) || !frozen_task_group(proc->tsk))
+  uid_t uid = sock_uid(sk);
+  if (!rekernel_net_filter(sk, uid, NET_PROTO_UDP))
     return;
 
-  binder_node_lock(node);
-  bool has_async_transaction = binder_node_has_async_transaction(node);
-  if (!has_async_transaction) {
-    binder_node_unlock(node);
-    return;
-  }
-  binder_inner_proc_lock(proc);
+  rekernel_report(NETWORK, NULL, NULL, NULL, uid, NULL, true, NULL);
+}
 
-  struct list_head* async_todo = binder_node_async_todo(node);
-  struct binder_transaction* t_outdated = binder_find_outdated_transaction_ilocked(t, async_todo);
-  if (t_outdated) {
-    list_del_init(&t_outdated->work.entry);
-    outstanding_txns_dec(proc);
-  }
+static void udp_enqueue_before(hook_fargs2_t* args, void* udata) {
+  uint64_t start = rekernel_latency_begin();
+  __udp_enqueue_before(args, udata);
+  rekernel_latency_end(LATENCY_UDP_ENQUEUE, start);
+}
 
-  binder_inner_proc_unlock(proc);
-  binder_node_unlock(node);
+static inline int rekernel_net_proto(struct sock* sk) {
+  if (sk->sk_family != AF_INET && sk->sk_family != AF_INET6)
+    return -1;
+  if (sk->sk_prot == kvar(tcp_prot) || sk->sk_prot == kvar(tcpv6_prot))
+    return NET_PROTO_TCP;
+  if (rekernel_net_udp == UZERO)
+    return -1;
+  if (sk->sk_prot == kvar(udp_prot) || sk->sk_prot == kvar(udpv6_prot))
+    return NET_PROTO_UDP;
+  return -1;
+}
 
-  if (t_outdated) {
-    struct binder_proc* proc = (struct binder_proc*)args->arg1;
-    struct binder_alloc* target_alloc = binder_proc_alloc(proc);
-    struct binder_buffer* buffer = binder_transaction_buffer(t_outdated);
-#ifdef CONFIG_DEBUG
-    logkm("free_outdated pid=%d,uid=%d,data_size=%d\n", proc->pid, task_uid(proc->tsk).val, buffer->data_size);
-#endif /* CONFIG_DEBUG */
+// 路由到本机且通过防火墙的包, TCP 连接与已 connect 的 UDP 由 early demux 关联 socket, 未关联的包不报告
+static unsigned int __rekernel_nf_local_in(struct sk_buff* skb) {
+  struct sock* sk = skb->sk;
+  if (sk == NULL || !sk_fullsock(sk))
+    return NF_ACCEPT;
+  int proto = rekernel_net_proto(sk);
+  if (proto < 0)
+    return NF_ACCEPT;
 
-    * (struct binder_buffer**)((uintptr_t)t_outdated + binder_transaction_buffer_offset) = NULL;
-    buffer->transaction = NULL;
-    binder_release_entire_buffer(proc, NULL, buffer, false);
-    binder_alloc_free_buf(target_alloc, buffer);
-    kfree(t_outdated);
-    binder_stats_deleted(BINDER_STAT_TRANSACTION);
-  }
+  uid_t uid = sock_uid(sk);
+  if (!rekernel_net_filter(sk, uid, proto))
+    return NF_ACCEPT;
+
+  rekernel_report(NETWORK, NULL, NULL, NULL, uid, NULL, true, NULL);
+  return NF_ACCEPT;
 }
 
-static void do_send_sig_info_before(hook_fargs4_t* args, void* udata) {
-  int sig = (int)args->arg0;
-  struct task_struct* dst = (struct task_struct*)args->arg2;
+static unsigned int rekernel_nf_local_in(void* priv, struct sk_buff* skb, const struct nf_hook_state* state) {
+  uint64_t start = rekernel_latency_begin();
+  unsigned int verdict = __rekernel_nf_local_in(skb);
+  rekernel_latency_end(LATENCY_NF_LOCAL_IN, start);
+  return verdict;
+}
 
-  if (sig == SIGKILL || sig == SIGTERM || sig == SIGABRT || sig == SIGQUIT) {
-    rekernel_report(SIGNAL, sig, task_tgid(current), current, task_tgid(dst), dst, false);
+static const struct nf_hook_ops rekernel_nf_ops[] = {
+  {
+    .hook = rekernel_nf_local_in,
+    .pf = NFPROTO_IPV4,
+    .hooknum = NF_INET_LOCAL_IN,
+    .priority = NF_IP_PRI_LAST,
+  },
+  {
+    .hook = rekernel_nf_local_in,
+    .pf = NFPROTO_IPV6,
+    .hooknum = NF_INET_LOCAL_IN,
+    .priority = NF_IP_PRI_LAST,
+  },
+};
+
+// netfilter 支持运行时注册与注销, 不修改内核代码. rekernel 线程与 inline_hook_exit 互斥, stop 后不再注册
+static void rekernel_net_nf_set(bool registered, bool stop) {
+  while (cmpxchg_u32(&rekernel_net_nf_lock, 0, 1) != 0)
+    schedule_timeout_interruptible(1);
+  if (!rekernel_net_nf_stopped && registered != !!rekernel_net_nf_registered) {
+    if (!registered) {
+      nf_unregister_net_hooks(kvar(init_net), rekernel_nf_ops, ARRAY_SIZE(rekernel_nf_ops));
+      smp_store_release(&rekernel_net_nf_registered, 0);
+    } else if (nf_register_net_hooks(kvar(init_net), rekernel_nf_ops, ARRAY_SIZE(rekernel_nf_ops))) {
+      logkm("register netfilter hooks failed\n");
+    } else {
+      smp_store_release(&rekernel_net_nf_registered, 1);
+    }
   }
+  if (stop)
+    rekernel_net_nf_stopped = 1;
+  smp_store_release(&rekernel_net_nf_lock, 0);
 }
 
-#ifdef CONFIG_NETWORK
-static inline bool sk_fullsock(const struct sock* sk) {
-  return (1 << sk->sk_state) & ~(TCPF_TIME_WAIT | TCPF_NEW_SYN_RECV);
+static void rekernel_net_nf_update(void) {
+  if (rekernel_net_ondemand != IZERO)
+    return;
+  bool frozen = false;
+  for (int i = 0; i < FROZEN_UID_WORDS && !frozen; i++) {
+    frozen = smp_load_acquire(&rekernel_frozen_uids[i]) != 0;
+  }
+  if (frozen != !!smp_load_acquire(&rekernel_net_nf_registered))
+    rekernel_net_nf_set(frozen, false);
 }
 
-static void tcp_rcv_before(hook_fargs1_t* args, void* udata) {
-  struct sk_buff* skb = (struct sk_buff*)args->arg0;
-  struct sock* sk = skb->sk;;
-  if (sk == NULL || !sk_fullsock(sk))
-    return;
+static long rekernel_net_hook(void) {
+  if (rekernel_net_engine == NET_ENGINE_SOCKET) {
+    kfunc_lookup_name(nf_register_net_hooks);
+    kfunc_lookup_name(nf_unregister_net_hooks);
+    if (!kfunc(nf_register_net_hooks) || !kfunc(nf_unregister_net_hooks))
+      return -21;
+    kvar_lookup_name(tcp_prot);
+    kvar_lookup_name(tcpv6_prot);
+    kvar_lookup_name(udp_prot);
+    kvar_lookup_name(udpv6_prot);
 
-  uid_t uid = sock_i_uid(sk).val;
-  if (uid < MIN_USERAPP_UID)
-    return;
+    // 有冻结位图时按需注册, 没有冻结应用时不影响网络路径
+    if (rekernel_frozen_bitmap == IZERO) {
+      rekernel_net_ondemand = IZERO;
+    } else {
+      rekernel_net_nf_set(true, false);
+      if (!rekernel_net_nf_registered)
+        return -23;
+    }
+  } else {
+    lookup_name(tcp_v4_rcv);
+    lookup_name(tcp_v6_rcv);
 
-  rekernel_report(NETWORK, NULL, NULL, NULL, uid, NULL, true);
+    hook_func(tcp_v4_rcv, 1, tcp_rcv_before, NULL, NULL);
+    hook_func(tcp_v6_rcv, 1, tcp_rcv_before, NULL, NULL);
+
+    // 4.10 之前没有 __udp_enqueue_schedule_skb, 此时不报告 UDP
+    __udp_enqueue_schedule_skb = (typeof(__udp_enqueue_schedule_skb))kallsyms_lookup_name("__udp_enqueue_schedule_skb");
+    if (__udp_enqueue_schedule_skb && hook_wrap(__udp_enqueue_schedule_skb, 2, udp_enqueue_before, NULL, NULL)) {
+      logkm("hook __udp_enqueue_schedule_skb failed\n");
+      __udp_enqueue_schedule_skb = 0;
+    }
+  }
+  rekernel_net_hooked = IZERO;
+  return 0;
 }
 #endif /* CONFIG_NETWORK */
 
@@ -574,6 +4353,48 @@ static long calculate_offsets() {
   if (binder_node_lock_offset == UZERO || binder_node_has_async_transaction_offset == UZERO || binder_transaction_buffer_offset == UZERO) {
     return -11;
   }
+  // 获取 binder_node->rb_node, binder_get_node_ilocked 沿 proc->nodes 查找时由 rb_node 指针直接读取 node->ptr 与参数比较,
+  // 之后沿 rb_left (0x10) 或 rb_right (0x8) 继续, 读取 ptr 的偏移即 ptr 与 rb_node 之差
+  uint64_t rb_node_delta = UZERO;
+  uint32_t* binder_get_node_src = (uint32_t*)kallsyms_lookup_name("binder_get_node_ilocked");
+  if (!binder_get_node_src)
+    binder_get_node_src = (uint32_t*)kallsyms_lookup_name("binder_get_node");
+  for (u32 i = 0; binder_get_node_src && i < 0x80 && rb_node_delta == UZERO; i++) {
+    if (binder_get_node_src[i] == ARM64_RET)
+      break;
+    if ((binder_get_node_src[i] & MASK_LDR_64_) != INST_LDR_64_)
+      continue;
+    uint32_t rt = bits32(binder_get_node_src[i], 4, 0);
+    uint32_t rn = bits32(binder_get_node_src[i], 9, 5);
+    uint64_t imm = (uint64_t)bits32(binder_get_node_src[i], 21, 10) << 0b11u;
+    if (imm <= 0x10)
+      continue;
+    bool compared = false;
+    for (u32 j = 1; j < 0x3; j++) {
+      uint32_t inst = binder_get_node_src[i + j];
+      if ((inst & MASK_CMP_64) == INST_CMP_64 && (bits32(inst, 9, 5) == rt || bits32(inst, 20, 16) == rt))
+        compared = true;
+    }
+    for (u32 j = 2; compared && j < 0x6; j++) {
+      uint32_t inst = binder_get_node_src[i + j];
+      uint64_t next = (uint64_t)bits32(inst, 21, 10) << 0b11u;
+      if ((inst & MASK_LDR_64_) == INST_LDR_64_ && bits32(inst, 9, 5) == rn && (next == 0x8 || next == 0x10)) {
+        rb_node_delta = imm; // 0x38
+        break;
+      }
+    }
+  }
+  if (rb_node_delta == UZERO) {
+    logkm("binder_node rb_node offset not found, assume ptr - 0x38\n");
+    rb_node_delta = 0x38;
+  }
+  binder_node_rb_node_offset = binder_node_ptr_offset - rb_node_delta; // 0x20
+  // rb_node 与 dead_node 共用, 之后紧跟 proc
+  binder_node_proc_offset = binder_node_rb_node_offset + 0x18;         // 0x38
+#ifdef CONFIG_DEBUG
+  logkm("binder_node_rb_node_offset=0x%llx\n", binder_node_rb_node_offset);
+  logkm("binder_node_proc_offset=0x%llx\n", binder_node_proc_offset);
+#endif /* CONFIG_DEBUG */
   // 获取 task_struct->jobctl
   void (*task_clear_jobctl_trapping)(struct task_struct* t);
   lookup_name(task_clear_jobctl_trapping);
@@ -698,17 +4519,588 @@ static long calculate_offsets() {
   if (binder_alloc_pid_offset == UZERO || task_struct_pid_offset == UZERO || task_struct_group_leader_offset == UZERO) {
     return -11;
   }
+#ifdef CONFIG_NETWORK
+  // 获取 SOCK_INODE(socket)->i_uid, 用于在 sock_init_data 中定位 sk_uid
+  uint64_t socket_i_uid_offset = UZERO;
+  uint32_t* sock_i_uid_src = (uint32_t*)kfunc(sock_i_uid);
+  for (u32 i = 0; i < 0x20 && socket_i_uid_offset == UZERO; i++) {
+#ifdef CONFIG_DEBUG
+    logkm("sock_i_uid %x %llx\n", i, sock_i_uid_src[i]);
+#endif /* CONFIG_DEBUG */
+    if (sock_i_uid_src[i] == ARM64_RET) {
+      break;
+    } else if ((sock_i_uid_src[i] & MASK_LDR_64_) == INST_LDR_64_) {
+      uint32_t rt = bits32(sock_i_uid_src[i], 4, 0);
+      for (u32 j = i + 1; j < i + 4; j++) {
+        if ((sock_i_uid_src[j] & MASK_LDR_32_) == INST_LDR_32_ && bits32(sock_i_uid_src[j], 9, 5) == rt) {
+          uint64_t imm12 = bits32(sock_i_uid_src[j], 21, 10);
+          socket_i_uid_offset = sign64_extend((imm12 << 0b10u), 16u);       // 0x84
+          break;
+        }
+      }
+    }
+  }
+  // 获取 sock->sk_uid, 失败时不影响加载
+  // 6.3 起 sock_init_data_uid(sock, sk, uid) 中 sk->sk_uid = uid, 之前 sock_init_data(sock, sk) 中 sk->sk_uid = SOCK_INODE(sock)->i_uid
+  // 跟踪保存 uid 与 sk 的寄存器 (包括 mov 到被调用者保存的寄存器), 第一个 str uid, [sk, #imm] 即为 sk_uid
+  uint32_t* sock_init_src = (uint32_t*)kallsyms_lookup_name("sock_init_data_uid");
+  uint32_t uid_regs = 1u << 2, sk_regs = 1u << 1;
+  if (!sock_init_src) {
+    sock_init_src = (uint32_t*)kallsyms_lookup_name("sock_init_data");
+    uid_regs = 0;
+  }
+  for (u32 i = 0; sock_init_src && i < 0x100 && sock_sk_uid_offset == UZERO; i++) {
+    uint32_t inst = sock_init_src[i];
+    uint32_t rd = bits32(inst, 4, 0);
+    uint32_t rn = bits32(inst, 9, 5);
+    if (inst == ARM64_RET) {
+      break;
+    } else if ((inst & MASK_MOV_Rn_WZR) == INST_MOV_Rn_WZR) {
+      uint32_t rm = bits32(inst, 20, 16);
+      uid_regs = (uid_regs & ~(1u << rd)) | (((uid_regs >> rm) & 1) << rd);
+      sk_regs = (sk_regs & ~(1u << rd)) | (((sk_regs >> rm) & 1) << rd);
+    } else if ((inst & MASK_LDR_32_) == INST_LDR_32_) {
+      uint64_t imm12 = bits32(inst, 21, 10);
+      if (socket_i_uid_offset != UZERO && (imm12 << 0b10u) == socket_i_uid_offset)
+        uid_regs |= 1u << rd;
+      else
+        uid_regs &= ~(1u << rd);
+    } else if ((inst & MASK_STR_32_) == INST_STR_32_ && ((uid_regs >> rd) & 1) && ((sk_regs >> rn) & 1)) {
+      uint64_t imm12 = bits32(inst, 21, 10);
+      sock_sk_uid_offset = imm12 << 0b10u;                                  // 0x2A4
+    } else if ((inst & MASK_BL) == INST_BL) {
+      // 调用会破坏 x0 ~ x18
+      uid_regs &= ~0x7FFFFu;
+      sk_regs &= ~0x7FFFFu;
+    } else if (bits32(inst, 28, 26) == 0b100 || bits32(inst, 27, 25) == 0b101 || (inst & MASK_LDR_64_) == INST_LDR_64_) {
+      // 其他数据处理与 64 位加载改写 rd
+      uid_regs &= ~(1u << rd);
+      sk_regs &= ~(1u << rd);
+    }
+  }
+#ifdef CONFIG_DEBUG
+  logkm("socket_i_uid_offset=0x%llx\n", socket_i_uid_offset);
+  logkm("sock_sk_uid_offset=0x%llx\n", sock_sk_uid_offset);
+#endif /* CONFIG_DEBUG */
+  if (sock_sk_uid_offset == UZERO) {
+    logkm("sk_uid not found, fallback to sock_i_uid\n");
+  }
+  // 获取 sock->sk_rmem_alloc, sock_rfree 中 atomic_sub(len, &skb->sk->sk_rmem_alloc), 失败时不影响加载
+  void (*sock_rfree)(struct sk_buff* skb);
+  sock_rfree = (typeof(sock_rfree))kallsyms_lookup_name("sock_rfree");
+  uint32_t* sock_rfree_src = (uint32_t*)sock_rfree;
+  for (u32 i = 0; sock_rfree && i < 0x10 && sock_rmem_alloc_offset == UZERO; i++) {
+#ifdef CONFIG_DEBUG
+    logkm("sock_rfree %x %llx\n", i, sock_rfree_src[i]);
+#endif /* CONFIG_DEBUG */
+    if (sock_rfree_src[i] == ARM64_RET) {
+      break;
+    } else if ((sock_rfree_src[i] & MASK_LDR_64_Rn_X0) == INST_LDR_64_Rn_X0) {
+      uint32_t rt = bits32(sock_rfree_src[i], 4, 0);
+      for (u32 j = i + 1; j < i + 6; j++) {
+        if ((sock_rfree_src[j] & MASK_ADD_64) == INST_ADD_64 && bits32(sock_rfree_src[j], 9, 5) == rt && !bits32(sock_rfree_src[j], 22, 22)) {
+          sock_rmem_alloc_offset = bits32(sock_rfree_src[j], 21, 10); // 0x12C
+          break;
+        }
+      }
+    }
+  }
+#ifdef CONFIG_DEBUG
+  logkm("sock_rmem_alloc_offset=0x%llx\n", sock_rmem_alloc_offset);
+#endif /* CONFIG_DEBUG */
+  if (sock_rmem_alloc_offset == UZERO && rekernel_net_backlog != UZERO) {
+    logkm("sock_rmem_alloc not found, net_backlog disabled\n");
+  }
+#endif /* CONFIG_NETWORK */
+
+  return 0;
+}
+
+static long rekernel_param_uint(const char* value, unsigned int max, unsigned long* res) {
+  int val;
+  int rc = kstrtoint(value, 0, &val);
+  if (rc)
+    return rc;
+  if (val < 0 || val > max)
+    return -ERANGE;
+  *res = val;
+  return 0;
+}
+
+// 参数格式: key=value, 多个参数以空格分隔
+// 双缓冲表只有一份备用表, 两个写者同时重建会互相覆盖, 所有表的写者共用一个锁
+// 参数只在进程上下文中设置, 竞争时让出 CPU 等待
+static uint32_t rekernel_table_writer;
+
+static long rekernel_table_set(long (*set)(char* value), char* value) {
+  while (cmpxchg_u32(&rekernel_table_writer, 0, 1) != 0)
+    schedule_timeout_interruptible(1);
+  long rc = set(value);
+  smp_store_release(&rekernel_table_writer, 0);
+  return rc;
+}
+
+static long rekernel_set_param(const char* key, char* value) {
+  if (!strcmp(key, "format")) {
+    if (!strcmp(value, "text")) {
+      rekernel_binary_format = UZERO;
+    } else if (!strcmp(value, "binary")) {
+      rekernel_binary_format = IZERO;
+    } else {
+      return -EINVAL;
+    }
+    return 0;
+  } else if (!strcmp(key, "flush_ms")) {
+    unsigned long flush_ms;
+    long rc = rekernel_param_uint(value, 10000, &flush_ms);
+    if (rc < 0)
+      return rc;
+    if (flush_ms == 0) {
+      rekernel_flush_ms = UZERO;
+    } else {
+      rekernel_flush_jiffies = msecs_to_jiffies(flush_ms);
+      rekernel_flush_ms = flush_ms;
+    }
+    // 切换模式时立即清空队列
+    rekernel_worker_wake();
+    return 0;
+  } else if (!strcmp(key, "batch")) {
+    unsigned long batch;
+    long rc = rekernel_param_uint(value, EVENT_BATCH_MAX, &batch);
+    if (rc < 0)
+      return rc;
+    if (batch == 0)
+      return -ERANGE;
+    rekernel_batch = batch;
+    return 0;
+  } else if (!strcmp(key, "rate")) {
+    unsigned long rate;
+    long rc = rekernel_param_uint(value, RATE_MAX, &rate);
+    if (rc < 0)
+      return rc;
+    rekernel_rate = rate ? rate : UZERO;
+    return 0;
+  } else if (!strcmp(key, "burst")) {
+    unsigned long burst;
+    long rc = rekernel_param_uint(value, RATE_MAX, &burst);
+    if (rc < 0)
+      return rc;
+    if (burst == 0)
+      return -ERANGE;
+    rekernel_burst = burst;
+    return 0;
+  } else if (!strcmp(key, "epoch")) {
+    unsigned long enabled;
+    long rc = rekernel_param_uint(value, 1, &enabled);
+    if (rc < 0)
+      return rc;
+    rekernel_epoch = enabled ? IZERO : UZERO;
+    return 0;
+#ifdef CONFIG_NETWORK
+  } else if (!strcmp(key, "net_window_ms")) {
+    unsigned long window;
+    long rc = rekernel_param_uint(value, 60000, &window);
+    if (rc < 0)
+      return rc;
+    if (window) {
+      rekernel_net_window_jiffies = msecs_to_jiffies(window);
+      rekernel_net_window = window;
+    } else {
+      rekernel_net_window = UZERO;
+    }
+    return 0;
+  } else if (!strcmp(key, "net_backlog")) {
+    unsigned long backlog;
+    long rc = rekernel_param_uint(value, NET_BACKLOG_MAX, &backlog);
+    if (rc < 0)
+      return rc;
+    rekernel_net_backlog = backlog ? backlog : UZERO;
+    return 0;
+  } else if (!strcmp(key, "net_deadline_ms")) {
+    unsigned long deadline;
+    long rc = rekernel_param_uint(value, 60000, &deadline);
+    if (rc < 0)
+      return rc;
+    if (deadline) {
+      rekernel_net_deadline_jiffies = msecs_to_jiffies(deadline);
+      rekernel_net_deadline = deadline;
+    } else {
+      rekernel_net_deadline = UZERO;
+    }
+    return 0;
+  } else if (!strcmp(key, "udp")) {
+    unsigned long enabled;
+    long rc = rekernel_param_uint(value, 1, &enabled);
+    if (rc < 0)
+      return rc;
+    rekernel_net_udp = enabled ? IZERO : UZERO;
+    return 0;
+  } else if (!strcmp(key, "net_filter")) {
+    return rekernel_table_set(rekernel_set_net_filter, value);
+  } else if (!strcmp(key, "net_engine")) {
+    unsigned long engine;
+    if (!strcmp(value, "tcp")) {
+      engine = NET_ENGINE_TCP;
+    } else if (!strcmp(value, "socket")) {
+      engine = NET_ENGINE_SOCKET;
+    } else {
+      return -EINVAL;
+    }
+    // hook 点只在加载时选择
+    if (rekernel_net_hooked == IZERO && engine != rekernel_net_engine)
+      return -EBUSY;
+    rekernel_net_engine = engine;
+    return 0;
+#endif /* CONFIG_NETWORK */
+  } else if (!strcmp(key, "binder_payload")) {
+    unsigned long bytes;
+    long rc = rekernel_param_uint(value, BINDER_PAYLOAD_MAX, &bytes);
+    if (rc < 0)
+      return rc;
+    // 指纹参与索引键, 切换后全部索引项失效
+    binder_payload = bytes ? bytes : UZERO;
+    if (binder_txn_index)
+      binder_txn_invalidate_all();
+    return 0;
+  } else if (!strcmp(key, "async_high")) {
+    unsigned long high;
+    long rc = rekernel_param_uint(value, 50, &high);
+    if (rc < 0)
+      return rc;
+    rekernel_async_high = high;
+    return 0;
+  } else if (!strcmp(key, "async_low")) {
+    unsigned long low;
+    long rc = rekernel_param_uint(value, 50, &low);
+    if (rc < 0)
+      return rc;
+    rekernel_async_low = low ? low : UZERO;
+    return 0;
+  } else if (!strcmp(key, "compact_on_freeze")) {
+    unsigned long enabled;
+    long rc = rekernel_param_uint(value, 1, &enabled);
+    if (rc < 0)
+      return rc;
+    rekernel_compact_on_freeze = enabled ? IZERO : UZERO;
+    return 0;
+  } else if (!strcmp(key, "compact")) {
+    if (!strcmp(value, "all")) {
+      rekernel_compact_request(0, 2);
+      return 0;
+    }
+    char* p = value;
+    while (*p) {
+      char* entry = p;
+      while (*p && *p != ',')
+        p++;
+      if (*p)
+        *p++ = '\0';
+      int uid;
+      if (kstrtoint(entry, 0, &uid))
+        return -EINVAL;
+      if (uid < 0 || uid % PER_USER_RANGE < MIN_USERAPP_UID)
+        return -ERANGE;
+      rekernel_compact_request(uid, 1);
+    }
+    return 0;
+  } else if (!strcmp(key, "binder_iface")) {
+    unsigned long enabled;
+    long rc = rekernel_param_uint(value, 1, &enabled);
+    if (rc < 0)
+      return rc;
+    binder_iface = enabled ? IZERO : UZERO;
+    return 0;
+  } else if (!strcmp(key, "latency")) {
+    if (!strcmp(value, "reset")) {
+      rekernel_latency_reset();
+      return 0;
+    }
+    unsigned long enabled;
+    long rc = rekernel_param_uint(value, 1, &enabled);
+    if (rc < 0)
+      return rc;
+    rekernel_latency = enabled ? IZERO : UZERO;
+    return 0;
+  } else if (!strcmp(key, "stats")) {
+    if (strcmp(value, "reset"))
+      return -EINVAL;
+    rekernel_stats_reset();
+    return 0;
+  } else if (!strcmp(key, "auto_thaw")) {
+    unsigned long enabled;
+    long rc = rekernel_param_uint(value, 1, &enabled);
+    if (rc < 0)
+      return rc;
+    rekernel_auto_thaw = enabled ? IZERO : UZERO;
+    return 0;
+  } else if (!strcmp(key, "thaw_lease_ms")) {
+    unsigned long lease;
+    long rc = rekernel_param_uint(value, THAW_LEASE_MAX_MS, &lease);
+    if (rc < 0)
+      return rc;
+    if (!lease)
+      return -ERANGE;
+    rekernel_thaw_lease = lease;
+    rekernel_thaw_lease_jiffies = msecs_to_jiffies(lease);
+    return 0;
+  } else if (!strcmp(key, "thaw_cancel")) {
+    int uid;
+    if (kstrtoint(value, 0, &uid))
+      return -EINVAL;
+    if (uid < 0)
+      return -ERANGE;
+    binder_thaw_cancel(uid, 0);
+    return 0;
+  } else if (!strcmp(key, "binder_filter")) {
+    return rekernel_table_set(binder_set_filter, value);
+  } else if (!strcmp(key, "binder_policy")) {
+    return rekernel_table_set(binder_set_policy, value);
+  } else if (!strcmp(key, "interest")) {
+    return rekernel_table_set(rekernel_set_interest, value);
+  } else if (!strcmp(key, "netlink")) {
+    unsigned long enabled;
+    long rc = rekernel_param_uint(value, 1, &enabled);
+    if (rc < 0)
+      return rc;
+    rekernel_netlink_enabled = enabled ? IZERO : UZERO;
+    return 0;
+  } else if (!strcmp(key, "unicast")) {
+    unsigned long enabled;
+    long rc = rekernel_param_uint(value, 1, &enabled);
+    if (rc < 0)
+      return rc;
+    rekernel_unicast = enabled ? IZERO : UZERO;
+    return 0;
+  } else if (!strcmp(key, "mmap_ring")) {
+    unsigned long nr;
+    long rc = rekernel_param_uint(value, MMAP_RING_MAX, &nr);
+    if (rc < 0)
+      return rc;
+    if (nr < MMAP_RING_MIN || (nr & (nr - 1)))
+      return -EINVAL;
+    // 用户态可能仍持有映射, 不支持调整大小
+    if (rekernel_mmap_ring)
+      return -EBUSY;
+    rc = rekernel_mmap_alloc(nr);
+    if (rc < 0)
+      return rc;
+    rekernel_create_files();
+    return 0;
+  } else if (!strcmp(key, "events")) {
+    unsigned long nr;
+    long rc = rekernel_param_uint(value, EVENTS_QUEUE_MAX, &nr);
+    if (rc < 0)
+      return rc;
+    if (nr < EVENTS_QUEUE_MIN || (nr & (nr - 1)))
+      return -EINVAL;
+    if (rekernel_events_queue)
+      return -EBUSY;
+    rc = rekernel_events_alloc(nr);
+    if (rc < 0)
+      return rc;
+    rekernel_create_files();
+    return 0;
+  }
+  return -EINVAL;
+}
+
+static long rekernel_parse_args(const char* args) {
+  if (!args)
+    return 0;
+
+  size_t len = strlen(args);
+  if (len >= ARGS_SIZE)
+    return -E2BIG;
+  // 规则表较大, 不放在栈上
+  char* buf = vmalloc(len + 1);
+  if (!buf)
+    return -ENOMEM;
+  memcpy(buf, args, len + 1);
+
+  long rc = 0;
+  char* p = buf;
+  while (*p) {
+    while (*p == ' ' || *p == '\n' || *p == '\t')
+      p++;
+    if (!*p)
+      break;
+
+    char* key = p;
+    while (*p && *p != ' ' && *p != '\n' && *p != '\t')
+      p++;
+    if (*p)
+      *p++ = '\0';
+
+    char* value = key;
+    while (*value && *value != '=')
+      value++;
+    if (*value != '=') {
+      rc = -EINVAL;
+      break;
+    }
+    *value++ = '\0';
+
+    rc = rekernel_set_param(key, value);
+    if (rc < 0) {
+      logkm("invalid param %s=%s\n", key, value);
+      break;
+    }
+  }
+  vfree(buf);
+  return rc < 0 ? rc : 0;
+}
+
+// 先创建 stats 与 latency 用于解析 struct file, 解析失败时不 hook
+static long rekernel_proc_hook(void) {
+  lookup_name(proc_reg_read);
+  lookup_name(proc_reg_poll);
+  lookup_name(proc_reg_mmap);
+
+  rekernel_create_file(REKERNEL_FILE_STATS, 0400);
+  rekernel_create_file(REKERNEL_FILE_LATENCY, 0400);
+  if (!rekernel_file_entry[REKERNEL_FILE_STATS] || !rekernel_file_entry[REKERNEL_FILE_LATENCY])
+    return -ENOMEM;
+  long rc = rekernel_proc_decode();
+  if (rc < 0)
+    return rc;
+
+  hook_func(proc_reg_read, 4, proc_reg_read_before, NULL, NULL);
+  hook_func(proc_reg_poll, 2, proc_reg_poll_before, NULL, NULL);
+  hook_func(proc_reg_mmap, 2, proc_reg_mmap_before, NULL, NULL);
+
+  rekernel_proc_hooked = IZERO;
+  return 0;
+}
+
+// 均为可选, 4.x 没有 cgroup_enter_frozen/cgroup_leave_frozen
+// 且可能由 cgroupv2_freeze 模拟冻结, 此时无法维护位图
+static void rekernel_freezer_hook(void) {
+  cgroup_enter_frozen = (typeof(cgroup_enter_frozen))kallsyms_lookup_name("cgroup_enter_frozen");
+  if (cgroup_enter_frozen && hook_wrap(cgroup_enter_frozen, 0, cgroup_enter_frozen_before, NULL, NULL)) {
+    logkm("hook cgroup_enter_frozen failed\n");
+    cgroup_enter_frozen = 0;
+  }
+  cgroup_leave_frozen = (typeof(cgroup_leave_frozen))kallsyms_lookup_name("cgroup_leave_frozen");
+  if (cgroup_leave_frozen && hook_wrap(cgroup_leave_frozen, 1, NULL, cgroup_leave_frozen_after, NULL)) {
+    logkm("hook cgroup_leave_frozen failed\n");
+    cgroup_leave_frozen = 0;
+  }
+  __refrigerator = (typeof(__refrigerator))kallsyms_lookup_name("__refrigerator");
+  if (__refrigerator && hook_wrap(__refrigerator, 1, __refrigerator_before, __refrigerator_after, NULL)) {
+    logkm("hook __refrigerator failed\n");
+    __refrigerator = 0;
+  }
+  // 用于在请求冻结时置位, 以及发现其他进程改写 cgroup.freeze, 没有时只能依靠 thaw_cancel
+  kfunc_lookup_name(kernfs_path_from_node);
+  cgroup_freeze_write = kfunc(kernfs_path_from_node) ? (typeof(cgroup_freeze_write))kallsyms_lookup_name("cgroup_freeze_write") : 0;
+  if (cgroup_freeze_write && hook_wrap(cgroup_freeze_write, 4, cgroup_freeze_write_before, cgroup_freeze_write_after, NULL)) {
+    logkm("hook cgroup_freeze_write failed\n");
+    cgroup_freeze_write = 0;
+  }
+  freeze_task = (typeof(freeze_task))kallsyms_lookup_name("freeze_task");
+  if (freeze_task && hook_wrap(freeze_task, 1, freeze_task_before, NULL, NULL)) {
+    logkm("hook freeze_task failed\n");
+    freeze_task = 0;
+  }
+
+  // 缺少请求冻结的 hook 时, 请求到进入冻结之间会漏报, 不使用位图, 热路径始终调用 frozen_task_group
+  if (cgroup_enter_frozen && cgroup_leave_frozen && __refrigerator && cgroup_freeze_write && freeze_task &&
+      kvar(binder_procs) && kvar(binder_procs_lock)) {
+    // 先 hook 再扫描, 扫描期间的冻结也会被记录
+    rekernel_frozen_scan(NULL, NULL);
+    rekernel_frozen_bitmap = IZERO;
+  }
+}
+
+static long rekernel_hook_init(void);
+static long inline_hook_exit(void* __user reserved);
 
+static long rekernel_percpu_alloc(void) {
+  size_t size = rekernel_nr_cpus * (sizeof(struct rekernel_stats) + sizeof(struct rekernel_latency_hist) +
+    sizeof(struct rekernel_ring) + sizeof(uint64_t));
+  void* mem = vmalloc(size);
+  if (!mem)
+    return -ENOMEM;
+  memset(mem, 0, size);
+  // 前三者按 64 字节对齐, 依次排列不破坏对齐
+  rekernel_stats = (struct rekernel_stats*)mem;
+  rekernel_latency_hists = (struct rekernel_latency_hist*)(rekernel_stats + rekernel_nr_cpus);
+  rekernel_rings = (struct rekernel_ring*)(rekernel_latency_hists + rekernel_nr_cpus);
+  binder_reclaim_heads = (uint64_t*)(rekernel_rings + rekernel_nr_cpus);
   return 0;
 }
 
 static long inline_hook_init(const char* args, const char* event, void* __user reserved) {
+  kfunc_lookup_name(kstrtoint);
+  kfunc_lookup_name(kstrtouint);
+  kfunc_lookup_name(__msecs_to_jiffies);
+  kfunc_lookup_name(ktime_get);
+  kvar_lookup_name(cpu_number);
+  kvar_lookup_name(jiffies_64);
+  kfunc_lookup_name(kthread_create_on_node);
+  kfunc_lookup_name(kthread_should_stop);
+  kfunc_lookup_name(kthread_stop);
+  kfunc_lookup_name(wake_up_process);
+  kfunc_lookup_name(schedule_timeout_interruptible);
+  kfunc_lookup_name(vmalloc_user);
+  kfunc_lookup_name(vfree);
+  kfunc_lookup_name(remap_vmalloc_range);
+  kfunc_lookup_name(__init_waitqueue_head);
+  kfunc_lookup_name(__wake_up);
+  kfunc_lookup_name(__wake_up_pollfree);
+  kfunc_lookup_name(synchronize_rcu);
+  kfunc_lookup_name(vmalloc);
+  kfunc_lookup_name(autoremove_wake_function);
+  kfunc_lookup_name(prepare_to_wait_event);
+  kfunc_lookup_name(finish_wait);
+  kfunc_lookup_name(schedule);
+  kfunc_lookup_name(filp_open);
+  kfunc_lookup_name(filp_close);
+  kfunc_lookup_name(kernel_read);
+  kfunc_lookup_name(kernel_write);
+  kfunc_lookup_name(_raw_spin_lock_irqsave);
+  kfunc_lookup_name(_raw_spin_unlock_irqrestore);
+
+  kvar_lookup_name(nr_cpu_ids);
+  rekernel_cpu_init();
+  // hook 与参数解析都会计数, 最先分配
+  long rc = rekernel_percpu_alloc();
+  if (rc < 0)
+    return rc;
+
+  rekernel_hz = msecs_to_jiffies(1000);
+  rekernel_thaw_lease_jiffies = msecs_to_jiffies(rekernel_thaw_lease);
+#ifdef CONFIG_NETWORK
+  rekernel_net_window_jiffies = msecs_to_jiffies(rekernel_net_window);
+  rekernel_net_deadline_jiffies = msecs_to_jiffies(rekernel_net_deadline);
+#endif /* CONFIG_NETWORK */
+  // 参数可能已经分配了事件队列, 失败时同样需要清理
+  rc = rekernel_parse_args(args);
+  if (rc < 0) {
+    inline_hook_exit(NULL);
+    return rc;
+  }
+
+  rc = rekernel_hook_init();
+  if (rc < 0) {
+    logkm("init failed: %ld\n", rc);
+    inline_hook_exit(NULL);
+    return rc;
+  }
+  return 0;
+}
+
+// lookup_name/hook_func 失败时直接返回, 由调用者执行 inline_hook_exit 撤销已完成的部分
+static long rekernel_hook_init(void) {
+  long rc;
   lookup_name(cgroup_freezing);
 
   kfunc_lookup_name(__alloc_skb);
   kfunc_lookup_name(__nlmsg_put);
   kfunc_lookup_name(kfree_skb);
   kfunc_lookup_name(netlink_unicast);
+  kfunc_lookup_name(netlink_broadcast);
+  kfunc_lookup_name(netlink_has_listeners);
 
   kvar_lookup_name(init_net);
   kfunc_lookup_name(__netlink_kernel_create);
@@ -730,67 +5122,202 @@ static long inline_hook_init(const char* args, const char* event, void* __user r
   binder_transaction_buffer_release_v4 = (typeof(binder_transaction_buffer_release_v4))binder_transaction_buffer_release;
   binder_transaction_buffer_release_v3 = (typeof(binder_transaction_buffer_release_v3))binder_transaction_buffer_release;
   lookup_name(binder_alloc_free_buf);
+  binder_alloc_copy_from_buffer = (typeof(binder_alloc_copy_from_buffer))kallsyms_lookup_name("binder_alloc_copy_from_buffer");
   kfunc_lookup_name(kfree);
+  kfunc_lookup_name(rb_first);
+  kfunc_lookup_name(rb_next);
   kvar_lookup_name(binder_stats);
+  kvar_lookup_name(binder_procs);
+  kvar_lookup_name(binder_procs_lock);
+  kfunc_lookup_name(mutex_lock);
+  kfunc_lookup_name(mutex_unlock);
 
   lookup_name(binder_proc_transaction);
   lookup_name(do_send_sig_info);
 
 #ifdef CONFIG_NETWORK
   kfunc_lookup_name(sock_i_uid);
-
-  lookup_name(tcp_v4_rcv);
-  lookup_name(tcp_v6_rcv);
 #endif /* CONFIG_NETWORK */
 #ifdef CONFIG_DEBUG_CMDLINE
   kfunc_lookup_name(get_cmdline);
 #endif /* CONFIG_DEBUG_CMDLINE */
 
-  int rc = 0;
   rc = calculate_offsets();
   if (rc < 0)
     return rc;
 
+  hook_func(binder_proc_transaction, 3, binder_proc_transaction_before, binder_proc_transaction_after, NULL);
+  hook_func(do_send_sig_info, 4, do_send_sig_info_before, NULL, NULL);
+
+  // 网络 hook 需要知道冻结位图是否可用
+  rekernel_freezer_hook();
+
+#ifdef CONFIG_NETWORK
+  rc = rekernel_net_hook();
+  if (rc < 0)
+    return rc;
+#endif /* CONFIG_NETWORK */
+
+  // 所有 hook 成功后再分配, 不能观察所有解冻或分配失败时按原方式遍历 async_todo
+  if (rekernel_frozen_bitmap == IZERO) {
+    struct binder_txn_index* txn_index = vmalloc(TXN_INDEX_SHARDS * sizeof(struct binder_txn_index));
+    if (txn_index) {
+      memset(txn_index, 0, TXN_INDEX_SHARDS * sizeof(struct binder_txn_index));
+      for (int i = 0; i < TXN_INDEX_SHARDS; i++) {
+        memset(txn_index[i].ptr_heads, 0xFF, sizeof(txn_index[i].ptr_heads));
+        memset(txn_index[i].key_heads, 0xFF, sizeof(txn_index[i].key_heads));
+        memset(txn_index[i].key_tails, 0xFF, sizeof(txn_index[i].key_tails));
+      }
+      smp_store_release(&binder_txn_index, txn_index);
+    } else {
+      logkm("alloc binder_txn_index failed\n");
+    }
+  }
+
+  init_waitqueue_head(&rekernel_worker_wait);
+  // 必需的 hook 全部成功后再启动线程与 trace, 此前的事件直接发送, binder_proc_transaction 代替 trace 报告
+  struct task_struct* worker = kthread_create(rekernel_worker, NULL, "rekernel");
+  if (IS_ERR(worker)) {
+    logkm("create rekernel worker failed: %ld\n", PTR_ERR(worker));
+  } else {
+    rekernel_worker_task = worker;
+    wake_up_process(worker);
+  }
+  // 失败时不使用自动解冻
+  init_waitqueue_head(&binder_thaw_wait);
+  struct task_struct* thaw = kthread_create(binder_thaw_worker, NULL, "rekernel_thaw");
+  if (IS_ERR(thaw)) {
+    logkm("create rekernel_thaw failed: %ld\n", PTR_ERR(thaw));
+  } else {
+    binder_thaw_task = thaw;
+    wake_up_process(thaw);
+  }
+
   rc = tracepoint_probe_register(kvar(__tracepoint_binder_transaction), rekernel_binder_transaction, NULL);
   if (rc == 0) {
     trace = IZERO;
   }
 
-  hook_func(binder_proc_transaction, 3, binder_proc_transaction_before, NULL, NULL);
-  hook_func(do_send_sig_info, 4, do_send_sig_info_before, NULL, NULL);
-
-#ifdef CONFIG_NETWORK
-  hook_func(tcp_v4_rcv, 1, tcp_rcv_before, NULL, NULL);
-  hook_func(tcp_v6_rcv, 1, tcp_rcv_before, NULL, NULL);
-#endif /* CONFIG_NETWORK */
+  // 在加载时创建, 不依赖 netlink 服务, netlink 单元号文件在服务创建后加入
+  // hook 失败时仅禁用 /proc/rekernel/ 下的文件, 不影响 netlink
+  rekernel_dir = proc_mkdir("rekernel", NULL);
+  if (!rekernel_dir) {
+    printk("create /proc/rekernel failed!\n");
+  } else if (rekernel_proc_hook() < 0) {
+    logkm("hook proc_reg failed, /proc/rekernel files disabled\n");
+    rekernel_remove_files();
+  } else {
+    rekernel_create_files();
+  }
 
   return 0;
 }
 
 static long inline_hook_control0(const char* ctl_args, char* __user out_msg, int outlen) {
   char msg[64];
-  snprintf(msg, sizeof(msg), "_(._.)_");
+  if (rekernel_parse_args(ctl_args) < 0) {
+    snprintf(msg, sizeof(msg), "_(x_x)_");
+  } else {
+    snprintf(msg, sizeof(msg), "_(._.)_");
+  }
   compat_copy_to_user(out_msg, msg, sizeof(msg));
   return 0;
 }
 
 static long inline_hook_exit(void* __user reserved) {
-  if (rekernel_netlink) {
-    netlink_kernel_release(rekernel_netlink);
-  }
-  if (rekernel_dir) {
-    proc_remove(rekernel_dir);
+  if (trace == IZERO) {
+    tracepoint_probe_unregister(kvar(__tracepoint_binder_transaction), rekernel_binder_transaction, NULL);
+    trace = UZERO;
   }
 
-  tracepoint_probe_unregister(kvar(__tracepoint_binder_transaction), rekernel_binder_transaction, NULL);
-
   unhook_func(binder_proc_transaction);
   unhook_func(do_send_sig_info);
+  unhook_func(cgroup_enter_frozen);
+  unhook_func(cgroup_leave_frozen);
+  unhook_func(__refrigerator);
+  unhook_func(cgroup_freeze_write);
+  unhook_func(freeze_task);
 
 #ifdef CONFIG_NETWORK
   unhook_func(tcp_v4_rcv);
   unhook_func(tcp_v6_rcv);
+  rekernel_net_nf_set(false, true);
+  unhook_func(__udp_enqueue_schedule_skb);
+#endif /* CONFIG_NETWORK */
+
+  // 唤醒阻塞的读者, 之后进入 hook 的读者直接返回
+  rekernel_exiting = IZERO;
+  smp_mb();
+  if (rekernel_events_wait)
+    wake_up_interruptible(rekernel_events_wait);
+  if (rekernel_mmap_wait)
+    wake_up_interruptible(rekernel_mmap_wait);
+
+  // 线程退出前会发送剩余事件, 需在释放 netlink 之前停止
+  if (binder_thaw_task) {
+    kthread_stop(binder_thaw_task);
+    binder_thaw_task = NULL;
+  }
+  if (rekernel_worker_task) {
+    kthread_stop(rekernel_worker_task);
+    rekernel_worker_task = NULL;
+  }
+  if (rekernel_netlink) {
+    netlink_kernel_release(rekernel_netlink);
+    rekernel_netlink = NULL;
+  }
+  if (rekernel_dir) {
+    proc_remove(rekernel_dir);
+    rekernel_dir = NULL;
+  }
+
+  unhook_func(proc_reg_read);
+  unhook_func(proc_reg_poll);
+  unhook_func(proc_reg_mmap);
+  while (smp_load_acquire(&rekernel_proc_users)) {
+    schedule_timeout_interruptible(1);
+  }
+  // 已建立的映射持有页面引用, 可以直接释放
+  if (rekernel_mmap_ring) {
+    vfree(rekernel_mmap_ring);
+    rekernel_mmap_ring = NULL;
+  }
+  if (rekernel_events_queue) {
+    vfree(rekernel_events_queue);
+    rekernel_events_queue = NULL;
+  }
+  if (binder_async_cache) {
+    vfree(binder_async_cache);
+    binder_async_cache = NULL;
+  }
+  rekernel_wait_release(&rekernel_mmap_wait);
+  rekernel_wait_release(&rekernel_events_wait);
+#ifdef CONFIG_NETWORK
+  for (int i = 0; i < 2; i++) {
+    if (rekernel_net_tables[i]) {
+      vfree(rekernel_net_tables[i]);
+      rekernel_net_tables[i] = NULL;
+    }
+  }
 #endif /* CONFIG_NETWORK */
+  if (binder_compact_buf.slots) {
+    vfree(binder_compact_buf.slots);
+    binder_compact_buf.slots = NULL;
+  }
+  if (binder_txn_index) {
+    vfree(binder_txn_index);
+    binder_txn_index = NULL;
+  }
+  if (rekernel_interest_masks) {
+    rekernel_interest = UZERO;
+    vfree(rekernel_interest_masks);
+    rekernel_interest_masks = NULL;
+  }
+  // 未释放的回收链表与环形队列中的事件一同丢弃
+  if (rekernel_stats) {
+    vfree(rekernel_stats);
+    rekernel_stats = NULL;
+  }
 
   return 0;
 }
@@ -183,7 +183,13 @@ struct sk_buff;
 struct net;
 struct sock;
 struct netlink_kernel_cfg {
-  char unknow[0x30];
+  unsigned int groups;
+  unsigned int flags;
+  void (*input)(struct sk_buff* skb);
+  struct mutex* cb_mutex;
+  int (*bind)(struct net* net, int group);
+  void (*unbind)(struct net* net, int group);
+  char unknow[0x08]; // 4.x: compare
 };
 
 struct nlmsghdr {
@@ -197,16 +203,25 @@ struct nlmsghdr {
 #define NLMSG_ALIGN(len) (((len) + NLMSG_ALIGNTO - 1) & ~(NLMSG_ALIGNTO - 1))
 #define NLMSG_HDRLEN ((int)NLMSG_ALIGN(sizeof(struct nlmsghdr)))
 #define NLMSG_LENGTH(len) ((len) + NLMSG_HDRLEN)
+#define NLM_F_MULTI 0x2
 
 // linux/gfp.h
 #define NUMA_NO_NODE (-1)
 #define ___GFP_HIGH 0x20u
+#define ___GFP_IO 0x40u
+#define ___GFP_FS 0x80u
 #define ___GFP_ATOMIC 0x80000u
+#define ___GFP_DIRECT_RECLAIM 0x200000u
 #define ___GFP_KSWAPD_RECLAIM 0x400000u
 #define __GFP_HIGH ((__force gfp_t)___GFP_HIGH)
 #define __GFP_ATOMIC ((__force gfp_t)___GFP_ATOMIC)
 #define __GFP_KSWAPD_RECLAIM ((__force gfp_t)___GFP_KSWAPD_RECLAIM)
+#define __GFP_IO ((__force gfp_t)___GFP_IO)
+#define __GFP_FS ((__force gfp_t)___GFP_FS)
+#define __GFP_DIRECT_RECLAIM ((__force gfp_t)___GFP_DIRECT_RECLAIM)
+#define __GFP_RECLAIM ((__force gfp_t)(___GFP_DIRECT_RECLAIM | ___GFP_KSWAPD_RECLAIM))
 #define GFP_ATOMIC (__GFP_HIGH | __GFP_ATOMIC | __GFP_KSWAPD_RECLAIM)
+#define GFP_KERNEL (__GFP_RECLAIM | __GFP_IO | __GFP_FS)
 
 // linux/fs.h
 struct kiocb;
@@ -223,6 +238,46 @@ struct file_operations {
   char unknow[0x120];
 };
 
+// 布局随版本变化, 用到的成员偏移在加载时解析
+struct file;
+
+// linux/kernfs.h, 只用到第一个成员
+struct kernfs_node;
+struct kernfs_open_file {
+  struct kernfs_node* kn;
+  // unknow
+};
+
+// uapi/asm-generic/fcntl.h
+#define O_RDONLY 00000000
+#define O_WRONLY 00000001
+#define O_NONBLOCK 00004000
+
+// linux/wait.h
+struct wait_queue_entry;
+typedef int (*wait_queue_func_t)(struct wait_queue_entry* wq_entry, unsigned mode, int flags, void* key);
+struct wait_queue_entry {
+  unsigned int flags;
+  void* private;
+  wait_queue_func_t func;
+  struct list_head entry;
+};
+
+// linux/poll.h
+typedef void (*poll_queue_proc)(struct file*, wait_queue_head_t*, struct poll_table_struct*);
+struct poll_table_struct {
+  poll_queue_proc _qproc;
+  __poll_t _key;
+};
+
+// uapi/linux/eventpoll.h
+#define EPOLLIN 0x00000001
+#define EPOLLRDNORM 0x00000040
+
+// linux/sched.h
+#define TASK_INTERRUPTIBLE 0x0001
+#define MAX_SCHEDULE_TIMEOUT ((long)(~0UL >> 1))
+
 // linux/schde.h
 #define PF_FROZEN 0x00010000
 
@@ -235,8 +290,29 @@ struct file_operations {
 struct siginfo;
 
 // linux/socket.h
+#define AF_INET 2
+#define AF_INET6 10
 #define MSG_DONTWAIT 0x40
 
+// linux/netfilter.h, 4.14 起的布局, 5.15 起 pf 之后的 hook_ops_type 为 0
+#define NF_ACCEPT 1
+#define NFPROTO_IPV4 2
+#define NFPROTO_IPV6 10
+#define NF_INET_LOCAL_IN 1
+#define NF_IP_PRI_LAST 0x7fffffff
+struct net;
+struct net_device;
+struct nf_hook_state;
+typedef unsigned int nf_hookfn(void* priv, struct sk_buff* skb, const struct nf_hook_state* state);
+struct nf_hook_ops {
+  nf_hookfn* hook;
+  struct net_device* dev;
+  void* priv;
+  u8 pf;
+  unsigned int hooknum;
+  int priority;
+};
+
 // linux/tracepoint-defs.h
 struct tracepoint;
 
@@ -93,3 +93,18 @@ static inline struct list_head* binder_node_async_todo(struct binder_node* node)
     struct list_head* async_todo = (struct list_head*)((uintptr_t)node + binder_node_async_todo_offset);
     return async_todo;
 }
+// file_inode
+static inline struct inode* file_inode(struct file* file) {
+    struct inode* inode = *(struct inode**)((uintptr_t)file + file_inode_offset);
+    return inode;
+}
+// file_flags
+static inline unsigned int file_flags(struct file* file) {
+    unsigned int flags = *(unsigned int*)((uintptr_t)file + file_flags_offset);
+    return flags;
+}
+// proc_inode_pde, PDE(inode)
+static inline struct proc_dir_entry* proc_inode_pde(struct inode* inode) {
+    struct proc_dir_entry* pde = *(struct proc_dir_entry**)((uintptr_t)inode - proc_inode_pde_offset);
+    return pde;
+}
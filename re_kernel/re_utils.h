@@ -46,13 +46,16 @@ typedef uint32_t inst_mask_t;
 #define INST_MOV_Rm_3_Rn_WZR 0x2A0303E0u
 #define INST_MOV_Rm_4_Rn_WZR 0x2A0403E0u
 #define INST_MOV_Rm_WZR 0x2A1F03E0u
+#define INST_MOV_Rn_WZR 0x2A0003E0u
 #define INST_MRS_SP_EL0 0xD5384100u
 #define INST_STR_Rn_SP_Rt_3 0xB90003E3u
 #define INST_STR_Rn_SP_Rt_4 0xB90003E4u
+#define INST_STR_32_ 0xB9000000u
 #define INST_STR_32_x0 0xB9000000u
 #define INST_STR_32_Rt_WZR 0xB900001Fu
 #define INST_STR_64_Rt_WZR 0xF900001Fu
 #define INST_STRB 0x39000000u
+#define INST_CMP_64 0xEB00001Fu
 #define INST_CBZ 0x34000000
 #define INST_CBNZ 0x35000000
 #define INST_TBZ 0x36000000u
@@ -85,13 +88,16 @@ typedef uint32_t inst_mask_t;
 #define MASK_MOV_Rm_3_Rn_WZR 0x7FFFFFE0u
 #define MASK_MOV_Rm_4_Rn_WZR 0x7FFFFFE0u
 #define MASK_MOV_Rm_WZR 0x7FFFFFE0u
+#define MASK_MOV_Rn_WZR 0x7FE0FFE0u
 #define MASK_MRS_SP_EL0 0xFFFFFFE0u
 #define MASK_STR_Rn_SP_Rt_3 0xBFC003FFu
 #define MASK_STR_Rn_SP_Rt_4 0xBFC003FFu
+#define MASK_STR_32_ 0xFFC00000u
 #define MASK_STR_32_x0 0xFFC003E0u
 #define MASK_STR_32_Rt_WZR 0xFFC0001Fu
 #define MASK_STR_64_Rt_WZR 0xFFC0001Fu
 #define MASK_STRB 0xFFC00000u
+#define MASK_CMP_64 0xFF20001Fu
 #define MASK_CBZ 0x7F000000u
 #define MASK_CBNZ 0x7F000000u
 #define MASK_TBZ 0x7F000000u
@@ -106,6 +112,113 @@ typedef uint32_t inst_mask_t;
 
 #define logkm(fmt, ...) printk("re_kernel: " fmt, ##__VA_ARGS__)
 
+// arch/arm64/include/asm/barrier.h
+#ifndef smp_load_acquire
+#define smp_load_acquire(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#endif
+#ifndef smp_store_release
+#define smp_store_release(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#endif
+#ifndef smp_mb
+#define smp_mb() asm volatile("dmb ish" ::: "memory")
+#endif
+
+// arch/arm64/include/asm/cmpxchg.h, 避免编译器生成 outline atomics
+static inline uint32_t cmpxchg_u32(volatile uint32_t* ptr, uint32_t old, uint32_t new) {
+  uint32_t oldval, tmp;
+  asm volatile(
+    "1: ldaxr %w[oldval], %[v]\n"
+    "   cmp %w[oldval], %w[old]\n"
+    "   b.ne 2f\n"
+    "   stlxr %w[tmp], %w[new], %[v]\n"
+    "   cbnz %w[tmp], 1b\n"
+    "2:"
+    : [oldval] "=&r"(oldval), [tmp] "=&r"(tmp), [v] "+Q"(*ptr)
+    : [old] "r"(old), [new] "r"(new)
+    : "cc", "memory");
+  return oldval;
+}
+
+static inline uint64_t cmpxchg_u64(volatile uint64_t* ptr, uint64_t old, uint64_t new) {
+  uint64_t oldval;
+  uint32_t tmp;
+  asm volatile(
+    "1: ldaxr %[oldval], %[v]\n"
+    "   cmp %[oldval], %[old]\n"
+    "   b.ne 2f\n"
+    "   stlxr %w[tmp], %[new], %[v]\n"
+    "   cbnz %w[tmp], 1b\n"
+    "2:"
+    : [oldval] "=&r"(oldval), [tmp] "=&r"(tmp), [v] "+Q"(*ptr)
+    : [old] "r"(old), [new] "r"(new)
+    : "cc", "memory");
+  return oldval;
+}
+
+static inline uint32_t xchg_u32(volatile uint32_t* ptr, uint32_t new) {
+  uint32_t oldval, tmp;
+  asm volatile(
+    "1: ldaxr %w[oldval], %[v]\n"
+    "   stlxr %w[tmp], %w[new], %[v]\n"
+    "   cbnz %w[tmp], 1b\n"
+    : [oldval] "=&r"(oldval), [tmp] "=&r"(tmp), [v] "+Q"(*ptr)
+    : [new] "r"(new)
+    : "memory");
+  return oldval;
+}
+
+static inline uint32_t add_return_u32(volatile uint32_t* ptr, uint32_t val) {
+  uint32_t result, tmp;
+  asm volatile(
+    "1: ldaxr %w[result], %[v]\n"
+    "   add %w[result], %w[result], %w[val]\n"
+    "   stlxr %w[tmp], %w[result], %[v]\n"
+    "   cbnz %w[tmp], 1b\n"
+    : [result] "=&r"(result), [tmp] "=&r"(tmp), [v] "+Q"(*ptr)
+    : [val] "r"(val)
+    : "memory");
+  return result;
+}
+
+static inline void or_u64(volatile uint64_t* ptr, uint64_t val) {
+  uint64_t result;
+  uint32_t tmp;
+  asm volatile(
+    "1: ldxr %[result], %[v]\n"
+    "   orr %[result], %[result], %[val]\n"
+    "   stlxr %w[tmp], %[result], %[v]\n"
+    "   cbnz %w[tmp], 1b\n"
+    : [result] "=&r"(result), [tmp] "=&r"(tmp), [v] "+Q"(*ptr)
+    : [val] "r"(val)
+    : "memory");
+}
+
+static inline void andnot_u64(volatile uint64_t* ptr, uint64_t val) {
+  uint64_t result;
+  uint32_t tmp;
+  asm volatile(
+    "1: ldxr %[result], %[v]\n"
+    "   bic %[result], %[result], %[val]\n"
+    "   stlxr %w[tmp], %[result], %[v]\n"
+    "   cbnz %w[tmp], 1b\n"
+    : [result] "=&r"(result), [tmp] "=&r"(tmp), [v] "+Q"(*ptr)
+    : [val] "r"(val)
+    : "memory");
+}
+
+static inline uint64_t xchg_u64(volatile uint64_t* ptr, uint64_t new) {
+  uint64_t oldval;
+  uint32_t tmp;
+  asm volatile(
+    "1: ldaxr %[oldval], %[v]\n"
+    "   stlxr %w[tmp], %[new], %[v]\n"
+    "   cbnz %w[tmp], 1b\n"
+    : [oldval] "=&r"(oldval), [tmp] "=&r"(tmp), [v] "+Q"(*ptr)
+    : [new] "r"(new)
+    : "memory");
+  return oldval;
+}
+
 #define lookup_name(func)                                  \
   func = 0;                                                \
   func = (typeof(func))kallsyms_lookup_name(#func);        \
@@ -195,6 +308,20 @@ static inline int netlink_unicast(struct sock* ssk, struct sk_buff* skb, u32 por
   return -ESRCH;
 }
 
+extern int kfunc_def(netlink_broadcast)(struct sock* ssk, struct sk_buff* skb, u32 portid, u32 group, gfp_t allocation);
+static inline int netlink_broadcast(struct sock* ssk, struct sk_buff* skb, u32 portid, u32 group, gfp_t allocation) {
+  kfunc_call(netlink_broadcast, ssk, skb, portid, group, allocation);
+  kfunc_not_found();
+  return -ESRCH;
+}
+
+extern int kfunc_def(netlink_has_listeners)(struct sock* sk, unsigned int group);
+static inline int netlink_has_listeners(struct sock* sk, unsigned int group) {
+  kfunc_call(netlink_has_listeners, sk, group);
+  kfunc_not_found();
+  return 0;
+}
+
 extern struct sock* kfunc_def(__netlink_kernel_create)(struct net* net, int unit, struct module* module, struct netlink_kernel_cfg* cfg);
 static inline struct sock* netlink_kernel_create(struct net* net, int unit, struct netlink_kernel_cfg* cfg) {
   kfunc_call(__netlink_kernel_create, net, unit, THIS_MODULE, cfg);
@@ -233,6 +360,18 @@ static inline kuid_t sock_i_uid(struct sock* sk) {
   return (kuid_t) { 0 };
 }
 
+extern int kfunc_def(nf_register_net_hooks)(struct net* net, const struct nf_hook_ops* reg, unsigned int n);
+static inline int nf_register_net_hooks(struct net* net, const struct nf_hook_ops* reg, unsigned int n) {
+  kfunc_call(nf_register_net_hooks, net, reg, n);
+  kfunc_not_found();
+  return -ESRCH;
+}
+
+extern void kfunc_def(nf_unregister_net_hooks)(struct net* net, const struct nf_hook_ops* reg, unsigned int n);
+static inline void nf_unregister_net_hooks(struct net* net, const struct nf_hook_ops* reg, unsigned int n) {
+  kfunc_call_void(nf_unregister_net_hooks, net, reg, n);
+}
+
 extern int kfunc_def(get_cmdline)(struct task_struct* task, char* buffer, int buflen);
 static inline int get_cmdline(struct task_struct* task, char* buffer, int buflen) {
   kfunc_call(get_cmdline, task, buffer, buflen);
@@ -259,4 +398,212 @@ static inline void kfree(const void* objp) {
   kfunc_call_void(kfree, objp);
 }
 
+extern int kfunc_def(kstrtoint)(const char* s, unsigned int base, int* res);
+static inline int kstrtoint(const char* s, unsigned int base, int* res) {
+  kfunc_call(kstrtoint, s, base, res);
+  kfunc_not_found();
+  return -EINVAL;
+}
+
+extern int kfunc_def(kstrtouint)(const char* s, unsigned int base, unsigned int* res);
+static inline int kstrtouint(const char* s, unsigned int base, unsigned int* res) {
+  kfunc_call(kstrtouint, s, base, res);
+  kfunc_not_found();
+  return -EINVAL;
+}
+
+extern struct task_struct* kfunc_def(kthread_create_on_node)(int (*threadfn)(void* data), void* data, int node, const char namefmt[], ...);
+static inline struct task_struct* kthread_create(int (*threadfn)(void* data), void* data, const char* name) {
+  kfunc_call(kthread_create_on_node, threadfn, data, NUMA_NO_NODE, name);
+  kfunc_not_found();
+  return (struct task_struct*)-ESRCH;
+}
+
+extern bool kfunc_def(kthread_should_stop)(void);
+static inline bool kthread_should_stop(void) {
+  kfunc_call(kthread_should_stop);
+  kfunc_not_found();
+  return true;
+}
+
+extern int kfunc_def(kthread_stop)(struct task_struct* k);
+static inline int kthread_stop(struct task_struct* k) {
+  kfunc_call(kthread_stop, k);
+  kfunc_not_found();
+  return -ESRCH;
+}
+
+extern int kfunc_def(wake_up_process)(struct task_struct* p);
+static inline int wake_up_process(struct task_struct* p) {
+  kfunc_call(wake_up_process, p);
+  kfunc_not_found();
+  return 0;
+}
+
+extern long kfunc_def(schedule_timeout_interruptible)(long timeout);
+static inline long schedule_timeout_interruptible(long timeout) {
+  kfunc_call(schedule_timeout_interruptible, timeout);
+  kfunc_not_found();
+  return 0;
+}
+
+extern unsigned long kfunc_def(__msecs_to_jiffies)(const unsigned int m);
+static inline unsigned long msecs_to_jiffies(const unsigned int m) {
+  kfunc_call(__msecs_to_jiffies, m);
+  kfunc_not_found();
+  return m;
+}
+
+extern void* kfunc_def(vmalloc_user)(unsigned long size);
+static inline void* vmalloc_user(unsigned long size) {
+  kfunc_call(vmalloc_user, size);
+  kfunc_not_found();
+  return NULL;
+}
+
+extern void* kfunc_def(vmalloc)(unsigned long size);
+static inline void* vmalloc(unsigned long size) {
+  kfunc_call(vmalloc, size);
+  kfunc_not_found();
+  return NULL;
+}
+
+extern struct file* kfunc_def(filp_open)(const char* filename, int flags, umode_t mode);
+static inline struct file* filp_open(const char* filename, int flags, umode_t mode) {
+  kfunc_call(filp_open, filename, flags, mode);
+  kfunc_not_found();
+  return (struct file*)-ESRCH;
+}
+
+extern int kfunc_def(filp_close)(struct file* filp, void* id);
+static inline int filp_close(struct file* filp, void* id) {
+  kfunc_call(filp_close, filp, id);
+  kfunc_not_found();
+  return -ESRCH;
+}
+
+// 4.14 起的签名
+extern ssize_t kfunc_def(kernel_read)(struct file* file, void* buf, size_t count, loff_t* pos);
+static inline ssize_t kernel_read(struct file* file, void* buf, size_t count, loff_t* pos) {
+  kfunc_call(kernel_read, file, buf, count, pos);
+  kfunc_not_found();
+  return -ESRCH;
+}
+
+extern int kfunc_def(kernfs_path_from_node)(struct kernfs_node* to, struct kernfs_node* from, char* buf, size_t buflen);
+static inline int kernfs_path_from_node(struct kernfs_node* to, struct kernfs_node* from, char* buf, size_t buflen) {
+  kfunc_call(kernfs_path_from_node, to, from, buf, buflen);
+  kfunc_not_found();
+  return -ESRCH;
+}
+
+extern ssize_t kfunc_def(kernel_write)(struct file* file, const void* buf, size_t count, loff_t* pos);
+static inline ssize_t kernel_write(struct file* file, const void* buf, size_t count, loff_t* pos) {
+  kfunc_call(kernel_write, file, buf, count, pos);
+  kfunc_not_found();
+  return -ESRCH;
+}
+
+extern void kfunc_def(vfree)(const void* addr);
+static inline void vfree(const void* addr) {
+  kfunc_call_void(vfree, addr);
+}
+
+extern int kfunc_def(remap_vmalloc_range)(struct vm_area_struct* vma, void* addr, unsigned long pgoff);
+static inline int remap_vmalloc_range(struct vm_area_struct* vma, void* addr, unsigned long pgoff) {
+  kfunc_call(remap_vmalloc_range, vma, addr, pgoff);
+  kfunc_not_found();
+  return -ESRCH;
+}
+
+extern void kfunc_def(__init_waitqueue_head)(wait_queue_head_t* wq_head, const char* name, void* key);
+static inline void __init_waitqueue_head(wait_queue_head_t* wq_head, const char* name, void* key) {
+  kfunc_call_void(__init_waitqueue_head, wq_head, name, key);
+}
+#define init_waitqueue_head(wq_head) __init_waitqueue_head(wq_head, #wq_head, NULL)
+
+extern void kfunc_def(__wake_up)(wait_queue_head_t* wq_head, unsigned int mode, int nr, void* key);
+static inline void wake_up_interruptible(wait_queue_head_t* wq_head) {
+  kfunc_call_void(__wake_up, wq_head, TASK_INTERRUPTIBLE, 1, NULL);
+}
+
+extern void kfunc_def(synchronize_rcu)(void);
+static inline void synchronize_rcu(void) {
+  kfunc_call_void(synchronize_rcu);
+}
+
+extern int kfunc_def(autoremove_wake_function)(struct wait_queue_entry* wq_entry, unsigned mode, int sync, void* key);
+static inline void init_wait_entry(struct wait_queue_entry* wq_entry, int flags) {
+  wq_entry->flags = flags;
+  wq_entry->private = current;
+  wq_entry->func = kfunc(autoremove_wake_function);
+  INIT_LIST_HEAD(&wq_entry->entry);
+}
+
+extern long kfunc_def(prepare_to_wait_event)(wait_queue_head_t* wq_head, struct wait_queue_entry* wq_entry, int state);
+static inline long prepare_to_wait_event(wait_queue_head_t* wq_head, struct wait_queue_entry* wq_entry, int state) {
+  kfunc_call(prepare_to_wait_event, wq_head, wq_entry, state);
+  kfunc_not_found();
+  return -ESRCH;
+}
+
+extern void kfunc_def(finish_wait)(wait_queue_head_t* wq_head, struct wait_queue_entry* wq_entry);
+static inline void finish_wait(wait_queue_head_t* wq_head, struct wait_queue_entry* wq_entry) {
+  kfunc_call_void(finish_wait, wq_head, wq_entry);
+}
+
+extern void kfunc_def(schedule)(void);
+static inline void schedule(void) {
+  kfunc_call_void(schedule);
+}
+
+static inline bool wq_has_sleeper(wait_queue_head_t* wq_head) {
+  smp_mb();
+  return wq_head->head.next != &wq_head->head;
+}
+
+// 唤醒时带 POLLFREE, epoll 随即摘除等待项
+#define POLLFREE 0x4000
+extern void kfunc_def(__wake_up_pollfree)(wait_queue_head_t* wq_head);
+static inline void wake_up_pollfree(wait_queue_head_t* wq_head) {
+  if (wq_has_sleeper(wq_head))
+    kfunc_call_void(__wake_up_pollfree, wq_head);
+}
+
+static inline void poll_wait(struct file* filp, wait_queue_head_t* wait_address, struct poll_table_struct* p) {
+  if (p && p->_qproc && wait_address)
+    p->_qproc(filp, wait_address, p);
+}
+
+extern void kfunc_def(mutex_lock)(struct mutex* lock);
+static inline void mutex_lock(struct mutex* lock) {
+  kfunc_call_void(mutex_lock, lock);
+}
+
+extern void kfunc_def(mutex_unlock)(struct mutex* lock);
+static inline void mutex_unlock(struct mutex* lock) {
+  kfunc_call_void(mutex_unlock, lock);
+}
+
+extern ktime_t kfunc_def(ktime_get)(void);
+static inline ktime_t ktime_get(void) {
+  kfunc_call(ktime_get);
+  kfunc_not_found();
+  return 0;
+}
+
+extern struct rb_node* kfunc_def(rb_first)(const struct rb_root* root);
+static inline struct rb_node* rb_first(const struct rb_root* root) {
+  kfunc_call(rb_first, root);
+  kfunc_not_found();
+  return NULL;
+}
+
+extern struct rb_node* kfunc_def(rb_next)(const struct rb_node* node);
+static inline struct rb_node* rb_next(const struct rb_node* node) {
+  kfunc_call(rb_next, node);
+  kfunc_not_found();
+  return NULL;
+}
+
 #endif /* __RE_UTILS_H */